@@ -0,0 +1,101 @@
+#include "kdtree.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// Nodes visited, recall and distance ratio of (1 + epsilon)-approximate k nearest search
+// against the exact one on uniformly distributed points.
+// Usage: approximate_nearest [points] [queries] [k]
+
+namespace {
+
+using Tree = kdtree::StaticTree<2>;
+
+std::vector<Tree::Point> uniform_points(const std::size_t n, std::mt19937_64 & random)
+{
+    std::uniform_real_distribution<double> coord(0, 1);
+    std::vector<Tree::Point> points;
+    points.reserve(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        const double x = coord(random);
+        const double y = coord(random);
+        points.push_back({x, y});
+    }
+    return points;
+}
+
+// neighbours of every query, closest first
+std::vector<Tree::BinaryHeap> search(const Tree & tree,
+                                     const std::vector<Tree::Point> & queries,
+                                     const std::size_t k,
+                                     const double epsilon,
+                                     std::size_t & visited,
+                                     double & seconds)
+{
+    std::vector<Tree::BinaryHeap> result(queries.size());
+    visited = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < queries.size(); ++i) {
+        visited += tree.nearest(queries[i], k, result[i], epsilon);
+        std::sort_heap(result[i].begin(), result[i].end());
+    }
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+} // anonymous namespace
+
+int main(int argc, char ** argv)
+{
+    const std::size_t n = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+    const std::size_t q = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 100000;
+    const std::size_t k = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 10;
+
+    std::mt19937_64 random(42);
+    auto points = uniform_points(n, random);
+    // the (y, x) order of Point, in which PointSet hands its points to the tree
+    std::sort(points.begin(), points.end(), [](const Tree::Point & a, const Tree::Point & b) {
+        return a[1] < b[1] || (a[1] == b[1] && a[0] < b[0]);
+    });
+    points.erase(std::unique(points.begin(), points.end()), points.end());
+    const Tree tree(std::move(points));
+    const auto queries = uniform_points(q, random);
+
+    std::size_t exact_visited;
+    double exact_seconds;
+    const auto exact = search(tree, queries, k, 0, exact_visited, exact_seconds);
+
+    std::cout << n << " points, " << q << " queries, k = " << k << "\n";
+    std::cout << std::setw(8) << "epsilon" << std::setw(14) << "nodes/query" << std::setw(10) << "recall"
+              << std::setw(12) << "max ratio" << std::setw(14) << "queries/s" << "\n";
+    for (const double epsilon : {0.0, 0.1, 0.25, 0.5, 1.0, 2.0, 4.0}) {
+        std::size_t visited;
+        double seconds;
+        const auto approximate = search(tree, queries, k, epsilon, visited, seconds);
+        std::size_t found = 0;
+        std::size_t total = 0;
+        double max_ratio = 1;
+        for (std::size_t i = 0; i < q; ++i) {
+            total += exact[i].size();
+            for (std::size_t j = 0; j < approximate[i].size(); ++j) {
+                const Tree::Point & p = approximate[i][j].point;
+                found += std::any_of(exact[i].begin(), exact[i].end(), [&p](const Tree::Distance & d) {
+                    return d.point == p;
+                });
+                if (exact[i][j].distance > 0) {
+                    max_ratio = std::max(max_ratio, std::sqrt(approximate[i][j].distance / exact[i][j].distance));
+                }
+            }
+        }
+        std::cout << std::setw(8) << epsilon << std::setw(14) << static_cast<double>(visited) / q
+                  << std::setw(10) << static_cast<double>(found) / total << std::setw(12) << max_ratio
+                  << std::setw(14) << static_cast<std::size_t>(q / seconds) << "\n";
+    }
+}
@@ -0,0 +1,265 @@
+#include "kdtree.h"
+#include "primitives.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+// Check of kdtree::KdTree against a brute force set and of kdtree::PointSet against the
+// KdTree<2, double> it wraps, with timings. PointSet has to return the same points in the same
+// order as a KdTree<2, double> given the same puts and erases; KdTree<2, double>,
+// KdTree<3, double> and KdTree<2, float> are checked against the brute force.
+// Sets stay below the size of background compactions, so both 2D forests evolve identically.
+// Exits with code 1 on the first mismatch.
+// Usage: kdtree_template [operations] [seed]
+
+// every member is compiled with the warnings of the build, used or not
+template class kdtree::KdTree<2, double>;
+template class kdtree::KdTree<3, double>;
+template class kdtree::KdTree<2, float>;
+template class kdtree::StaticTree<3, double>;
+template class kdtree::StaticTree<2, float>;
+
+namespace {
+
+using Plane = kdtree::KdTree<2, double>;
+
+// coordinates on a coarse grid, so that duplicates, erases of present points and equal distances occur
+template <class Scalar>
+Scalar coordinate(std::mt19937_64 & random)
+{
+    return static_cast<Scalar>(std::uniform_int_distribution<int>(0, 400)(random)) / 4;
+}
+
+template <class A, class B>
+bool same(const A & a, const B & b)
+{
+    return std::equal(a.begin(), a.end(), b.begin(), b.end());
+}
+
+std::vector<Plane::Point> convert(const kdtree::PointSet::iterator first, const kdtree::PointSet::iterator last)
+{
+    std::vector<Plane::Point> result;
+    for (auto it = first; it != last; ++it) {
+        result.push_back({it->x(), it->y()});
+    }
+    return result;
+}
+
+template <class Iterator>
+std::vector<typename std::iterator_traits<Iterator>::value_type> collect(const Iterator first, const Iterator last)
+{
+    return {first, last};
+}
+
+bool fail(const std::string & what, const std::size_t operation)
+{
+    std::cerr << "mismatch in " << what << " after operation " << operation << "\n";
+    return false;
+}
+
+bool check_plane(const std::size_t operations, std::mt19937_64 & random)
+{
+    kdtree::PointSet reference;
+    Plane tree;
+    for (std::size_t i = 0; i < operations; ++i) {
+        const double x = coordinate<double>(random);
+        const double y = coordinate<double>(random);
+        if (random() % 3 == 0) {
+            if (reference.erase(Point(x, y)) != tree.erase({x, y})) {
+                return fail("erase", i);
+            }
+        }
+        else {
+            reference.put(Point(x, y));
+            tree.put({x, y});
+        }
+        if (reference.size() != tree.size() || reference.contains(Point(x, y)) != tree.contains({x, y})) {
+            return fail("size or contains", i);
+        }
+        if (i % 64 != 0) {
+            continue;
+        }
+        if (!same(convert(reference.begin(), reference.end()), collect(tree.begin(), tree.end()))) {
+            return fail("iteration", i);
+        }
+        const double x1 = coordinate<double>(random);
+        const double y1 = coordinate<double>(random);
+        const Rect rect(Point(std::min(x, x1), std::min(y, y1)), Point(std::max(x, x1), std::max(y, y1)));
+        const Plane::Box box{{rect.xmin(), rect.ymin()}, {rect.xmax(), rect.ymax()}};
+        const auto [first, last] = reference.range(rect);
+        const auto [tree_first, tree_last] = tree.range(box);
+        if (!same(convert(first, last), collect(tree_first, tree_last)) || reference.range_count(rect) != tree.range_count(box)) {
+            return fail("range", i);
+        }
+        const std::size_t k = 1 + random() % 16;
+        const auto [near_first, near_last] = reference.nearest(Point(x1, y1), k);
+        const auto [tree_near_first, tree_near_last] = tree.nearest({x1, y1}, k);
+        if (!same(convert(near_first, near_last), collect(tree_near_first, tree_near_last))) {
+            return fail("nearest", i);
+        }
+    }
+    return true;
+}
+
+template <std::size_t Dim, class Scalar>
+Scalar squared_distance(const std::array<Scalar, Dim> & a, const std::array<Scalar, Dim> & b)
+{
+    Scalar result = 0;
+    for (std::size_t i = 0; i < Dim; ++i) {
+        result += (a[i] - b[i]) * (a[i] - b[i]);
+    }
+    return result;
+}
+
+template <std::size_t Dim, class Scalar>
+bool check_against_set(const std::size_t operations, std::mt19937_64 & random)
+{
+    using Tree = kdtree::KdTree<Dim, Scalar>;
+    using Point = typename Tree::Point;
+    const auto random_point = [&random] {
+        Point p;
+        for (auto & c : p) {
+            c = coordinate<Scalar>(random);
+        }
+        return p;
+    };
+
+    std::set<Point> reference;
+    Tree tree;
+    for (std::size_t i = 0; i < operations; ++i) {
+        const Point p = random_point();
+        if (random() % 3 == 0) {
+            if ((reference.erase(p) == 1) != tree.erase(p)) {
+                return fail("erase", i);
+            }
+        }
+        else {
+            reference.insert(p);
+            tree.put(p);
+        }
+        if (reference.size() != tree.size() || (reference.count(p) == 1) != tree.contains(p)) {
+            return fail("size or contains", i);
+        }
+        if (i % 64 != 0) {
+            continue;
+        }
+        auto points = collect(tree.begin(), tree.end());
+        std::sort(points.begin(), points.end());
+        if (!same(points, reference)) {
+            return fail("iteration", i);
+        }
+        const Point corner = random_point();
+        typename Tree::Box box;
+        for (std::size_t d = 0; d < Dim; ++d) {
+            box.min[d] = std::min(p[d], corner[d]);
+            box.max[d] = std::max(p[d], corner[d]);
+        }
+        std::vector<Point> inside;
+        std::copy_if(reference.begin(), reference.end(), std::back_inserter(inside), [&box](const Point & q) {
+            return box.contains(q);
+        });
+        const auto [first, last] = tree.range(box);
+        auto found = collect(first, last);
+        std::sort(found.begin(), found.end());
+        if (found != inside || tree.range_count(box) != inside.size()) {
+            return fail("range", i);
+        }
+        const Scalar r = coordinate<Scalar>(random) / 4;
+        std::vector<Point> near;
+        std::copy_if(reference.begin(), reference.end(), std::back_inserter(near), [&](const Point & q) {
+            return squared_distance(q, corner) <= r * r;
+        });
+        const auto [within_first, within_last] = tree.within(corner, r);
+        found = collect(within_first, within_last);
+        std::sort(found.begin(), found.end());
+        if (found != near) {
+            return fail("within", i);
+        }
+        // neighbours are compared by distance, equally distant points may be chosen either way
+        const std::size_t k = 1 + random() % 16;
+        std::vector<Scalar> expected;
+        for (const auto & q : reference) {
+            expected.push_back(squared_distance(q, corner));
+        }
+        std::sort(expected.begin(), expected.end());
+        expected.resize(std::min(k, expected.size()));
+        const auto [near_first, near_last] = tree.nearest(corner, k);
+        std::vector<Scalar> distances;
+        for (auto it = near_first; it != near_last; ++it) {
+            distances.push_back(squared_distance(*it, corner));
+        }
+        std::sort(distances.begin(), distances.end());
+        if (distances != expected) {
+            return fail("nearest", i);
+        }
+    }
+    return true;
+}
+
+// seconds to put n uniform points one by one and to answer q nearest queries with k = 10
+template <class Set, class Make>
+std::pair<double, double> measure(const std::size_t n, const std::size_t q, Make && make)
+{
+    std::mt19937_64 random(7);
+    std::uniform_real_distribution<double> coord(0, 1);
+    Set set;
+    const auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < n; ++i) {
+        const double x = coord(random);
+        const double y = coord(random);
+        set.put(make(x, y));
+    }
+    const auto built = std::chrono::steady_clock::now();
+    std::size_t found = 0;
+    for (std::size_t i = 0; i < q; ++i) {
+        const double x = coord(random);
+        const double y = coord(random);
+        const auto [first, last] = set.nearest(make(x, y), 10);
+        found += std::distance(first, last);
+    }
+    const auto queried = std::chrono::steady_clock::now();
+    if (found != q * std::min<std::size_t>(10, n)) {
+        std::cerr << "unexpected number of neighbours\n";
+    }
+    return {std::chrono::duration<double>(built - start).count(), std::chrono::duration<double>(queried - built).count()};
+}
+
+} // anonymous namespace
+
+int main(int argc, char ** argv)
+{
+    const std::size_t operations = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 20000;
+    const std::uint64_t seed = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 42;
+
+    std::mt19937_64 random(seed);
+    const bool ok = check_plane(operations, random) && check_against_set<2, double>(operations, random) &&
+            check_against_set<3, double>(operations, random) && check_against_set<2, float>(operations, random);
+    std::cout << (ok ? "KdTree agrees with PointSet and the brute force" : "KdTree differs") << " on " << operations << " operations\n";
+    if (!ok) {
+        return EXIT_FAILURE;
+    }
+
+    const std::size_t n = 200000;
+    const std::size_t q = 200000;
+    std::cout << std::setw(22) << "set" << std::setw(12) << "put, s" << std::setw(12) << "nearest, s" << "\n";
+    const auto print = [](const char * name, const std::pair<double, double> & seconds) {
+        std::cout << std::setw(22) << name << std::setw(12) << seconds.first << std::setw(12) << seconds.second << "\n";
+    };
+    print("PointSet", measure<kdtree::PointSet>(n, q, [](const double x, const double y) {
+        return Point(x, y);
+    }));
+    print("KdTree<2, double>", measure<Plane>(n, q, [](const double x, const double y) {
+        return Plane::Point{x, y};
+    }));
+    print("KdTree<2, float>", measure<kdtree::KdTree<2, float>>(n, q, [](const double x, const double y) {
+        return kdtree::KdTree<2, float>::Point{static_cast<float>(x), static_cast<float>(y)};
+    }));
+}
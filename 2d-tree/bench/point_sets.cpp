@@ -0,0 +1,312 @@
+#include "primitives.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Build and query timings of rbtree::PointSet and kdtree::PointSet on generated
+// datasets, printed as JSON to stdout. Every measurement runs its queries until
+// they are exhausted or the time budget is spent, the number done is reported.
+// Usage: point_sets [--sizes 1000,10000,...] [--distributions uniform,clustered,degenerate]
+//                   [--queries n] [--budget seconds] [--rbtree-max n] [--seed s]
+
+namespace {
+
+struct Options
+{
+    std::vector<std::size_t> sizes{1000, 10000, 100000, 1000000};
+    std::vector<std::string> distributions{"uniform", "clustered", "degenerate"};
+    std::size_t queries = 10000;
+    double budget = 1;
+    // the red-black tree takes about 100 bytes and a node allocation per point
+    std::size_t rbtree_max = 10000000;
+    std::uint64_t seed = 42;
+};
+
+// fractions of the bounding box area covered by a range query
+const double selectivities[] = {0.0001, 0.001, 0.01};
+const std::size_t k = 10;
+
+std::vector<std::string> split(const std::string & list)
+{
+    std::vector<std::string> result;
+    std::istringstream is(list);
+    std::string item;
+    while (std::getline(is, item, ',')) {
+        result.push_back(item);
+    }
+    return result;
+}
+
+Options parse(const int argc, char ** argv)
+{
+    Options options;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const std::string name = argv[i];
+        const std::string value = argv[i + 1];
+        if (name == "--sizes") {
+            options.sizes.clear();
+            for (const auto & size : split(value)) {
+                options.sizes.push_back(static_cast<std::size_t>(std::stod(size)));
+            }
+        }
+        else if (name == "--distributions") {
+            options.distributions = split(value);
+        }
+        else if (name == "--queries") {
+            options.queries = std::stoul(value);
+        }
+        else if (name == "--budget") {
+            options.budget = std::stod(value);
+        }
+        else if (name == "--rbtree-max") {
+            options.rbtree_max = static_cast<std::size_t>(std::stod(value));
+        }
+        else if (name == "--seed") {
+            options.seed = std::stoull(value);
+        }
+        else {
+            throw std::invalid_argument("Unknown option " + name);
+        }
+    }
+    return options;
+}
+
+// Gaussian blobs with centres spread uniformly over the unit square
+std::vector<Point> clustered(const std::size_t n, std::mt19937_64 & random)
+{
+    static constexpr std::size_t blobs = 16;
+    static constexpr double sigma = 0.01;
+
+    std::uniform_real_distribution<double> coord(0, 1);
+    std::vector<Point> centres;
+    for (std::size_t i = 0; i < blobs; ++i) {
+        const double x = coord(random);
+        const double y = coord(random);
+        centres.emplace_back(x, y);
+    }
+    std::uniform_int_distribution<std::size_t> blob(0, blobs - 1);
+    std::normal_distribution<double> offset(0, sigma);
+    std::vector<Point> points;
+    points.reserve(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        const Point & centre = centres[blob(random)];
+        const double x = centre.x() + offset(random);
+        const double y = centre.y() + offset(random);
+        points.emplace_back(x, y);
+    }
+    return points;
+}
+
+// points on one line taking only n / 8 distinct positions, so most of them are duplicates
+std::vector<Point> degenerate(const std::size_t n, std::mt19937_64 & random)
+{
+    const std::size_t positions = std::max<std::size_t>(n / 8, 1);
+    std::uniform_int_distribution<std::size_t> position(0, positions - 1);
+    std::vector<Point> points;
+    points.reserve(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        const double t = static_cast<double>(position(random)) / static_cast<double>(positions);
+        points.emplace_back(t, 0.5 * t + 0.25);
+    }
+    return points;
+}
+
+std::vector<Point> uniform(const std::size_t n, std::mt19937_64 & random)
+{
+    std::uniform_real_distribution<double> coord(0, 1);
+    std::vector<Point> points;
+    points.reserve(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        const double x = coord(random);
+        const double y = coord(random);
+        points.emplace_back(x, y);
+    }
+    return points;
+}
+
+std::vector<Point> generate(const std::string & distribution, const std::size_t n, std::mt19937_64 & random)
+{
+    if (distribution == "uniform") {
+        return uniform(n, random);
+    }
+    if (distribution == "clustered") {
+        return clustered(n, random);
+    }
+    if (distribution == "degenerate") {
+        return degenerate(n, random);
+    }
+    throw std::invalid_argument("Unknown distribution " + distribution);
+}
+
+Rect bounding_box(const std::vector<Point> & points)
+{
+    double xmin = std::numeric_limits<double>::max();
+    double ymin = std::numeric_limits<double>::max();
+    double xmax = std::numeric_limits<double>::lowest();
+    double ymax = std::numeric_limits<double>::lowest();
+    for (const auto & p : points) {
+        xmin = std::min(xmin, p.x());
+        ymin = std::min(ymin, p.y());
+        xmax = std::max(xmax, p.x());
+        ymax = std::max(ymax, p.y());
+    }
+    return Rect(Point(xmin, ymin), Point(xmax, ymax));
+}
+
+class Report
+{
+public:
+    explicit Report(const Options & options)
+    {
+        std::cout.precision(9);
+        std::cout << "{\n  \"benchmark\": \"2d-tree point sets\",\n  \"seed\": " << options.seed
+                  << ",\n  \"budget_seconds\": " << options.budget << ",\n  \"results\": [";
+    }
+
+    ~Report()
+    {
+        std::cout << "\n  ]\n}\n";
+    }
+
+    // one measurement, extra holds additional "key": value pairs
+    void add(const std::string & structure,
+             const std::string & distribution,
+             const std::size_t points,
+             const std::string & operation,
+             const std::size_t operations,
+             const double seconds,
+             const std::string & extra = {})
+    {
+        std::cout << (first ? "\n" : ",\n") << "    {\"structure\": \"" << structure << "\", \"distribution\": \"" << distribution
+                  << "\", \"points\": " << points << ", \"operation\": \"" << operation << "\", \"operations\": " << operations
+                  << ", \"seconds\": " << seconds << ", \"ns_per_operation\": " << seconds * 1e9 / static_cast<double>(std::max<std::size_t>(operations, 1))
+                  << extra << "}";
+        std::cout.flush();
+        first = false;
+    }
+
+private:
+    bool first = true;
+};
+
+// calls query(i) for i = 0, 1, ... until n queries are done or the budget is spent
+std::pair<std::size_t, double> run(const std::size_t n, const double budget, const std::function<void(std::size_t)> & query)
+{
+    using clock = std::chrono::steady_clock;
+    const auto start = clock::now();
+    std::size_t done = 0;
+    double seconds = 0;
+    while (done < n) {
+        query(done++);
+        // the clock is read every 16 queries, cheap ones would be dominated by it otherwise
+        if (done % 16 == 0 || done == n) {
+            seconds = std::chrono::duration<double>(clock::now() - start).count();
+            if (seconds > budget) {
+                break;
+            }
+        }
+    }
+    return {done, seconds};
+}
+
+std::string mean_results(const std::size_t found, const std::size_t done)
+{
+    std::ostringstream os;
+    os.precision(9);
+    os << ", \"mean_results\": " << static_cast<double>(found) / static_cast<double>(std::max<std::size_t>(done, 1));
+    return os.str();
+}
+
+template <class Set>
+void measure(Report & report,
+             const Options & options,
+             const std::string & structure,
+             const std::string & distribution,
+             const Set & set,
+             const std::vector<Point> & queries,
+             const Rect & box)
+{
+    const std::size_t n = set.size();
+    for (const double selectivity : selectivities) {
+        const double width = (box.xmax() - box.xmin()) * std::sqrt(selectivity);
+        const double height = (box.ymax() - box.ymin()) * std::sqrt(selectivity);
+        std::size_t found = 0;
+        const auto [done, seconds] = run(queries.size(), options.budget, [&](const std::size_t i) {
+            const Point & q = queries[i];
+            const auto result = set.range(Rect(Point(q.x() - width / 2, q.y() - height / 2), Point(q.x() + width / 2, q.y() + height / 2)));
+            found += static_cast<std::size_t>(std::distance(result.first, result.second));
+        });
+        std::ostringstream extra;
+        extra << ", \"selectivity\": " << selectivity << mean_results(found, done);
+        report.add(structure, distribution, n, "range", done, seconds, extra.str());
+    }
+    {
+        std::size_t found = 0;
+        const auto [done, seconds] = run(queries.size(), options.budget, [&](const std::size_t i) {
+            found += set.nearest(queries[i]).has_value() ? 1 : 0;
+        });
+        report.add(structure, distribution, n, "nearest", done, seconds, mean_results(found, done));
+    }
+    {
+        std::size_t found = 0;
+        const auto [done, seconds] = run(queries.size(), options.budget, [&](const std::size_t i) {
+            const auto result = set.nearest(queries[i], k);
+            found += static_cast<std::size_t>(std::distance(result.first, result.second));
+        });
+        std::ostringstream extra;
+        extra << ", \"k\": " << k << mean_results(found, done);
+        report.add(structure, distribution, n, "nearest_k", done, seconds, extra.str());
+    }
+}
+
+} // anonymous namespace
+
+int main(int argc, char ** argv)
+{
+    Options options;
+    try {
+        options = parse(argc, argv);
+    }
+    catch (const std::exception & e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+
+    Report report(options);
+    for (const auto & distribution : options.distributions) {
+        for (const std::size_t size : options.sizes) {
+            std::mt19937_64 random(options.seed);
+            const auto points = generate(distribution, size, random);
+            const auto queries = generate(distribution, options.queries, random);
+            const Rect box = bounding_box(points);
+            using clock = std::chrono::steady_clock;
+
+            {
+                const auto start = clock::now();
+                kdtree::PointSet set;
+                set.put(points);
+                report.add("kdtree", distribution, set.size(), "build", size, std::chrono::duration<double>(clock::now() - start).count());
+                measure(report, options, "kdtree", distribution, set, queries, box);
+            }
+            if (size <= options.rbtree_max) {
+                const auto start = clock::now();
+                rbtree::PointSet set;
+                for (const auto & p : points) {
+                    set.put(p);
+                }
+                report.add("rbtree", distribution, set.size(), "build", size, std::chrono::duration<double>(clock::now() - start).count());
+                measure(report, options, "rbtree", distribution, set, queries, box);
+            }
+        }
+    }
+}
@@ -0,0 +1,132 @@
+#include "primitives.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+// All k nearest join of PointSet against a loop of nearest calls over the queries, both
+// single threaded, on uniformly distributed points: every query of a set of customers gets
+// its k nearest depots, closest first as the join delivers them, so the loop sorts the distances
+// of every answer. Both have to find the same distances. Up to PointSet::dual_join_k the
+// join walks both trees together, above it searches for every query on its own; the last line
+// tells up to which k the join is faster, the walk should pay off at every k up to dual_join_k.
+// The two alternate for a few rounds and the best time of each is shown.
+// Usage: spatial_join [depots] [customers] [seed] [rounds]
+
+namespace {
+
+const std::size_t ks[] = {1, 2, 4, 8, 10, 16, 32, 64};
+
+std::vector<Point> uniform_points(const std::size_t n, std::mt19937_64 & random)
+{
+    std::uniform_real_distribution<double> coord(0, 1);
+    std::vector<Point> points;
+    points.reserve(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        const double x = coord(random);
+        const double y = coord(random);
+        points.emplace_back(x, y);
+    }
+    return points;
+}
+
+// order independent checksum of the distances found
+struct Result
+{
+    void add(const double distance)
+    {
+        std::uint64_t bits;
+        std::memcpy(&bits, &distance, sizeof(bits));
+        checksum += bits;
+        ++count;
+    }
+
+    std::uint64_t checksum = 0;
+    std::size_t count = 0;
+    double seconds = 0;
+};
+
+Result loop(const kdtree::PointSet & depots, const kdtree::PointSet & customers, const std::size_t k)
+{
+    Result result;
+    std::vector<double> distances;
+    const auto start = std::chrono::steady_clock::now();
+    for (const auto & customer : customers) {
+        const auto [first, last] = depots.nearest(customer, k);
+        distances.clear();
+        for (auto it = first; it != last; ++it) {
+            distances.push_back(customer.distance(*it));
+        }
+        std::sort(distances.begin(), distances.end());
+        for (const double distance : distances) {
+            result.add(distance);
+        }
+    }
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+Result join(const kdtree::PointSet & depots, const kdtree::PointSet & customers, const std::size_t k)
+{
+    Result result;
+    const auto start = std::chrono::steady_clock::now();
+    depots.join(customers, k, [&result](const Point &, const Point &, const double distance) {
+        result.add(distance);
+    });
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+} // anonymous namespace
+
+int main(int argc, char ** argv)
+{
+    const std::size_t n = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 200000;
+    const std::size_t q = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 1000000;
+    std::mt19937_64 random(argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 42);
+    const std::size_t rounds = argc > 4 ? std::max<std::size_t>(std::strtoul(argv[4], nullptr, 10), 1) : 3;
+
+    kdtree::PointSet depots;
+    depots.put(uniform_points(n, random));
+    kdtree::PointSet customers;
+    customers.put(uniform_points(q, random));
+    // the loop iterates the customers, it shouldn't pay for materializing them
+    customers.begin();
+
+    std::cout << depots.size() << " depots, " << customers.size() << " customers\n";
+    std::cout << std::setw(4) << "k" << std::setw(10) << "loop, s" << std::setw(10) << "join, s" << std::setw(10) << "speedup" << std::setw(8) << "join" << "\n";
+    std::size_t crossover = 0;
+    bool faster = true;
+    for (const std::size_t k : ks) {
+        auto expected = loop(depots, customers, k);
+        auto found = join(depots, customers, k);
+        if (found.count != expected.count || found.checksum != expected.checksum) {
+            std::cerr << "join and loop found different neighbours for k = " << k << "\n";
+            return EXIT_FAILURE;
+        }
+        for (std::size_t i = 1; i < rounds; ++i) {
+            expected.seconds = std::min(expected.seconds, loop(depots, customers, k).seconds);
+            found.seconds = std::min(found.seconds, join(depots, customers, k).seconds);
+        }
+        std::cout << std::setw(4) << k << std::setw(10) << expected.seconds << std::setw(10) << found.seconds << std::setw(10)
+                  << expected.seconds / found.seconds << std::setw(8) << (k > kdtree::PointSet::dual_join_k ? "search" : "walk") << "\n";
+        faster = faster && found.seconds < expected.seconds;
+        crossover = faster ? k : crossover;
+    }
+    std::cout << "the join walks both trees up to k = " << kdtree::PointSet::dual_join_k << "\n";
+    if (crossover == 0) {
+        std::cout << "the loop is faster for every k\n";
+    }
+    else if (faster) {
+        std::cout << "the join is faster for every k up to " << crossover << "\n";
+    }
+    else {
+        std::cout << "the join is faster up to k = " << crossover << "\n";
+    }
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "primitives.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace kdtree {
+
+// kd-tree point set shared between threads, RCU style. Readers take the latest
+// published snapshot and query it without locks, it never changes under them
+// and stays valid for as long as they hold it. Writers only queue their changes:
+// a background thread applies everything queued so far as one batch to its own
+// set and publishes a new snapshot, which shares all the trees the batch didn't
+// touch with the previous one.
+class ConcurrentPointSet
+{
+public:
+    explicit ConcurrentPointSet(PointSet points = PointSet());
+    ConcurrentPointSet(const ConcurrentPointSet &) = delete;
+    ConcurrentPointSet & operator=(const ConcurrentPointSet &) = delete;
+    // applies the changes queued so far before returning
+    ~ConcurrentPointSet();
+
+    std::shared_ptr<const PointSet> snapshot() const;
+
+    void put(const Point & p);
+    void erase(const Point & p);
+    // waits until every change queued before the call is visible in snapshot()
+    void flush();
+
+private:
+    struct Change
+    {
+        Point point;
+        bool erase;
+    };
+
+    void publish(const PointSet & points);
+    void apply(std::vector<Change> & batch);
+    void run();
+
+    // accessed with std::atomic_load and std::atomic_store only
+    std::shared_ptr<const PointSet> published;
+    // touched by the background thread only
+    PointSet set;
+
+    std::mutex mutex;
+    std::condition_variable queued_changes;
+    std::condition_variable published_changes;
+    std::vector<Change> queue;
+    std::uint64_t queued = 0;
+    std::uint64_t applied = 0;
+    bool stop = false;
+    std::thread worker;
+};
+
+} // namespace kdtree
@@ -0,0 +1,1225 @@
+#pragma once
+
+#include "kernels.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <array>
+#include <bitset>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <future>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Coordinates of the points of a text file, every line holds whole groups of dimension
+// whitespace separated numbers. The file is mapped and parsed in parallel chunks cut at line ends.
+struct CoordinateFile
+{
+    // dimension numbers per point
+    std::vector<double> coords;
+    // byte offsets of the lines that couldn't be parsed, ascending, they add no points
+    std::vector<std::size_t> malformed;
+};
+
+CoordinateFile read_coordinate_file(const std::string & filename, std::size_t dimension);
+
+// coordinates of a file for the constructors, malformed lines are reported to std::cerr and skipped
+std::vector<double> read_coordinates(const std::string & filename, std::size_t dimension);
+
+namespace kdtree {
+
+// Points, boxes and orders of a Dim-dimensional space with coordinates of type Scalar.
+// Everything is unrolled over the coordinates at compile time.
+template <std::size_t Dim, class Scalar>
+struct Geometry
+{
+    static_assert(Dim > 0, "a point needs at least one coordinate");
+    static_assert(std::is_floating_point_v<Scalar>, "coordinates must be floating point");
+
+    using Point = std::array<Scalar, Dim>;
+
+    template <class Predicate>
+    static bool all(Predicate && predicate)
+    {
+        return all(predicate, std::make_index_sequence<Dim>());
+    }
+    template <class Predicate, std::size_t... I>
+    static bool all(Predicate & predicate, std::index_sequence<I...>)
+    {
+        return (predicate(I) && ...);
+    }
+
+    // closed box, a point is inside if min[i] <= p[i] <= max[i] for every axis
+    struct Box
+    {
+        Point min;
+        Point max;
+
+        bool contains(const Point & p) const
+        {
+            return all([&](const std::size_t i) { return p[i] >= min[i] && p[i] <= max[i]; });
+        }
+
+        bool contains(const Box & box) const
+        {
+            return all([&](const std::size_t i) { return box.min[i] >= min[i] && box.max[i] <= max[i]; });
+        }
+
+        bool intersects(const Box & box) const
+        {
+            return all([&](const std::size_t i) { return max[i] >= box.min[i] && box.max[i] >= min[i]; });
+        }
+    };
+
+    // lexicographic order starting from Axis and cycling through the others, so points sharing
+    // the pivot coordinate are still split in a strict order; less<1> is Point::operator< for two
+    template <std::size_t Axis>
+    static bool less(const Point & a, const Point & b)
+    {
+        return less<Axis>(a, b, std::make_index_sequence<Dim>());
+    }
+    template <std::size_t Axis, std::size_t... I>
+    static bool less(const Point & a, const Point & b, std::index_sequence<I...>)
+    {
+        bool result = false;
+        (void)((a[(Axis + I) % Dim] != b[(Axis + I) % Dim] && (result = a[(Axis + I) % Dim] < b[(Axis + I) % Dim], true)) || ...);
+        return result;
+    }
+
+    static Scalar squared_distance(const Point & a, const Point & b)
+    {
+        return squared_distance(a, b, std::make_index_sequence<Dim>());
+    }
+    template <std::size_t... I>
+    static Scalar squared_distance(const Point & a, const Point & b, std::index_sequence<I...>)
+    {
+        // a left fold, so two coordinates round like dx * dx + dy * dy in the SIMD kernels
+        return (Scalar{0} + ... + ((a[I] - b[I]) * (a[I] - b[I])));
+    }
+};
+
+// Static k-d tree over a fixed set of distinct points.
+// The tree has an implicit layout: a subtree covering the index range [first, last)
+// has its node at the middle of the range, the left subtree to the left of it and
+// the right subtree to the right. Coordinates are kept in struct-of-arrays form,
+// so a point costs exactly Dim scalars and there are no child links at all.
+// Ranges of at most leaf_size points aren't split any further. The splitting axis
+// is a template parameter of every recursive step, so it cycles at compile time.
+// All arrays live in one memory block, which is either allocated by the tree or
+// a private mapping of a snapshot file.
+// StaticTree<2, double> scans its leaf buckets with the SIMD kernels of kernels.h,
+// other instances compare coordinate by coordinate.
+template <std::size_t Dim, class Scalar = double>
+class StaticTree
+{
+public:
+    using Point = typename Geometry<Dim, Scalar>::Point;
+    using Box = typename Geometry<Dim, Scalar>::Box;
+
+    // offsets of the arrays in the memory block of a tree with the given number of slots
+    struct Layout
+    {
+        explicit Layout(const std::size_t slots)
+        {
+            // every array starts on a cache line
+            const auto align = [](const std::size_t offset) {
+                return (offset + 63) / 64 * 64;
+            };
+            std::size_t offset = 0;
+            for (auto & axis : coords) {
+                axis = offset;
+                offset = align(offset + slots * sizeof(Scalar));
+            }
+            live = offset;
+            dead = align(live + slots * sizeof(std::uint32_t));
+            bytes = align(dead + (slots + 63) / 64 * sizeof(std::uint64_t));
+        }
+
+        std::array<std::size_t, Dim> coords;
+        std::size_t live;
+        std::size_t dead;
+        std::size_t bytes;
+    };
+
+    static constexpr std::size_t leaf_size = 32;
+
+    // distance is squared, that is enough to order candidates and saves square roots
+    struct Distance
+    {
+        Distance(const Scalar distance_, const Point & point_)
+            : distance(distance_)
+            , point(point_)
+        {
+        }
+
+        bool operator<(const Distance & that) const { return distance < that.distance; }
+        bool operator>(const Distance & that) const { return distance > that.distance; }
+        bool operator==(const Distance & that) const { return distance == that.distance; }
+        bool operator!=(const Distance & that) const { return !(*this == that); }
+        bool operator>=(const Distance & that) const { return !(*this < that); }
+        bool operator<=(const Distance & that) const { return !(*this > that); }
+
+        Scalar distance;
+        Point point;
+    };
+
+    // max-heap on distance, holds at most k best candidates
+    using BinaryHeap = std::vector<Distance>;
+
+    // points must not contain duplicates, subtrees larger than grain are built in parallel
+    explicit StaticTree(std::vector<Point> points, const std::size_t grain = std::numeric_limits<std::size_t>::max())
+        : bounds(bounding_box(points))
+        , slots(points.size())
+        , memory(std::calloc(1, std::max<std::size_t>(Layout(slots).bytes, 1)), std::free)
+    {
+        if (memory == nullptr) {
+            throw std::bad_alloc();
+        }
+        attach();
+        build<0>(points.begin(), points.end(), grain);
+        count_subtrees(0, slots);
+        const auto scatter = [this, &points](const std::size_t first, const std::size_t last) {
+            for (std::size_t i = first; i < last; ++i) {
+                for (std::size_t axis = 0; axis < Dim; ++axis) {
+                    coords[axis][i] = points[i][axis];
+                }
+            }
+        };
+        if (slots > grain) {
+            ThreadPool::instance().parallel_for(slots, grain, scatter);
+        }
+        else {
+            scatter(0, slots);
+        }
+    }
+
+    // adopts a block laid out by Layout, throws std::runtime_error if it is inconsistent
+    StaticTree(const Box & bounds_, const std::size_t slots_, std::shared_ptr<void> memory_, char * data_)
+        : bounds(bounds_)
+        , slots(slots_)
+        , memory(std::move(memory_))
+        , offset(static_cast<std::size_t>(data_ - static_cast<char *>(memory.get())))
+    {
+        attach();
+        for (std::size_t i = 0; i < (slots + 63) / 64; ++i) {
+            dead_count += std::bitset<64>(dead[i]).count();
+        }
+        if (slots % 64 != 0 && (dead[slots / 64] >> (slots % 64)) != 0) {
+            throw std::runtime_error("tombstones past the end of a tree");
+        }
+        if (slots > 0 && live[slots / 2] != slots - dead_count) {
+            throw std::runtime_error("subtree counts don't match tombstones");
+        }
+    }
+
+    StaticTree(const StaticTree & that)
+        : bounds(that.bounds)
+        , slots(that.slots)
+        , memory(std::malloc(std::max<std::size_t>(Layout(slots).bytes, 1)), std::free)
+        , dead_count(that.dead_count)
+    {
+        if (memory == nullptr) {
+            throw std::bad_alloc();
+        }
+        std::memcpy(memory.get(), that.data(), Layout(slots).bytes);
+        attach();
+    }
+
+    StaticTree(StaticTree && that) = default;
+
+    bool empty() const { return size() == 0; }
+    // number of live points, erased ones are kept as tombstones until the tree is rebuilt
+    std::size_t size() const { return slots - dead_count; }
+    double dead_fraction() const { return slots == 0 ? 0 : static_cast<double>(dead_count) / static_cast<double>(slots); }
+
+    const Box & region() const { return bounds; }
+    std::size_t slot_count() const { return slots; }
+    const char * data() const { return static_cast<const char *>(memory.get()) + offset; }
+
+    // one bit per slot
+    std::vector<std::uint64_t> tombstones() const { return std::vector<std::uint64_t>(dead, dead + (slots + 63) / 64); }
+
+    std::vector<Point> live_points() const
+    {
+        std::vector<Point> result;
+        result.reserve(size());
+        for_each([&result](const Point & p) {
+            result.push_back(p);
+        });
+        return result;
+    }
+
+    // the tree layout is immutable, so this may run concurrently with erase given a copy of the tombstones
+    std::vector<Point> live_points(const std::vector<std::uint64_t> & tombstones) const
+    {
+        std::vector<Point> result;
+        result.reserve(slots);
+        for (std::size_t i = 0; i < slots; ++i) {
+            if (((tombstones[i / 64] >> (i % 64)) & 1) == 0) {
+                result.push_back(point(i));
+            }
+        }
+        return result;
+    }
+
+    // calls callback for every live point in the order of the slots
+    template <class Callback>
+    void for_each(Callback && callback) const
+    {
+        for (std::size_t i = 0; i < slots; ++i) {
+            if (!is_dead(i)) {
+                callback(point(i));
+            }
+        }
+    }
+
+    bool erase(const Point & p)
+    {
+        const std::size_t i = find<0>(p, 0, slots);
+        if (i == slots || is_dead(i)) {
+            return false;
+        }
+        dead[i / 64] |= std::uint64_t{1} << (i % 64);
+        ++dead_count;
+        uncount<0>(p, i, 0, slots);
+        return true;
+    }
+
+    bool contains(const Point & p) const
+    {
+        const std::size_t i = find<0>(p, 0, slots);
+        return i < slots && !is_dead(i);
+    }
+
+    template <class Callback>
+    void range_for_each(const Box & box, Callback & callback) const
+    {
+        range_for_each<0>(0, slots, box, callback);
+    }
+
+    std::size_t range_count(const Box & box) const { return range_count<0>(0, slots, box, bounds); }
+
+    // calls callback for every point at distance at most r from p
+    template <class Callback>
+    void within_for_each(const Point & p, const Scalar r, Callback & callback) const
+    {
+        if (r >= 0) {
+            within_for_each<0>(0, slots, p, r * r, callback);
+        }
+    }
+
+    // Adds the k nearest points to the heap of the best candidates found so far.
+    // With epsilon > 0 a subtree is visited only if it may hold a point (1 + epsilon)
+    // times closer than the worst candidate, so every neighbour found is at most that
+    // much farther than the exact one. Returns the number of nodes and leaf buckets visited.
+    std::size_t nearest(const Point & p, const std::size_t k, BinaryHeap & heap, const double epsilon = 0) const
+    {
+        Search search{p, k, (1 + epsilon) * (1 + epsilon), heap, 0};
+        nearest<0>(0, slots, search);
+        return search.visited;
+    }
+
+private:
+    friend class Join;
+
+    // the leaf scans of the plane go through the SIMD kernels, which take two double coordinates
+    static constexpr bool planar = Dim == 2 && std::is_same_v<Scalar, double>;
+
+    static constexpr std::size_t next(const std::size_t axis) { return (axis + 1) % Dim; }
+
+    // Subtrees occupy disjoint ranges once their parent is partitioned, so they are
+    // built independently and the layout doesn't depend on how the work was scheduled.
+    template <std::size_t Axis>
+    static void build(const typename std::vector<Point>::iterator first,
+                      const typename std::vector<Point>::iterator last,
+                      const std::size_t grain)
+    {
+        if (static_cast<std::size_t>(last - first) <= leaf_size) {
+            return;
+        }
+        const auto middle = first + (last - first) / 2;
+        std::nth_element(first, middle, last, [](const Point & a, const Point & b) {
+            return Geometry<Dim, Scalar>::template less<Axis>(a, b);
+        });
+        if (static_cast<std::size_t>(last - first) <= grain) {
+            build<next(Axis)>(first, middle, grain);
+            build<next(Axis)>(middle + 1, last, grain);
+            return;
+        }
+        ThreadPool::instance().fork_join([&] { build<next(Axis)>(first, middle, grain); },
+                                         [&] { build<next(Axis)>(middle + 1, last, grain); });
+    }
+
+    static Box bounding_box(const std::vector<Point> & points)
+    {
+        Box box;
+        box.min.fill(points.empty() ? 0 : std::numeric_limits<Scalar>::max());
+        box.max.fill(points.empty() ? 0 : std::numeric_limits<Scalar>::lowest());
+        for (const auto & p : points) {
+            for (std::size_t i = 0; i < Dim; ++i) {
+                box.min[i] = std::min(box.min[i], p[i]);
+                box.max[i] = std::max(box.max[i], p[i]);
+            }
+        }
+        return box;
+    }
+
+    void count_subtrees(const std::size_t first, const std::size_t last)
+    {
+        if (first >= last) {
+            return;
+        }
+        // a leaf keeps its count in the middle slot as well
+        const std::size_t middle = first + (last - first) / 2;
+        live[middle] = static_cast<std::uint32_t>(last - first);
+        if (last - first <= leaf_size) {
+            return;
+        }
+        count_subtrees(first, middle);
+        count_subtrees(middle + 1, last);
+    }
+
+    void attach()
+    {
+        const Layout layout(slots);
+        char * block = static_cast<char *>(memory.get()) + offset;
+        for (std::size_t axis = 0; axis < Dim; ++axis) {
+            coords[axis] = reinterpret_cast<Scalar *>(block + layout.coords[axis]);
+        }
+        live = reinterpret_cast<std::uint32_t *>(block + layout.live);
+        dead = reinterpret_cast<std::uint64_t *>(block + layout.dead);
+    }
+
+    Point point(const std::size_t i) const
+    {
+        Point p;
+        for (std::size_t axis = 0; axis < Dim; ++axis) {
+            p[axis] = coords[axis][i];
+        }
+        return p;
+    }
+
+    bool is_dead(const std::size_t i) const { return ((dead[i / 64] >> (i % 64)) & 1) != 0; }
+
+    template <std::size_t Axis>
+    std::size_t find(const Point & p, const std::size_t first, const std::size_t last) const
+    {
+        if (last - first <= leaf_size) {
+            for (std::size_t i = first; i < last; ++i) {
+                if (Geometry<Dim, Scalar>::all([&](const std::size_t axis) { return coords[axis][i] == p[axis]; })) {
+                    return i;
+                }
+            }
+            return slots;
+        }
+        const std::size_t middle = first + (last - first) / 2;
+        const Point node = point(middle);
+        if (node == p) {
+            return middle;
+        }
+        if (Geometry<Dim, Scalar>::template less<Axis>(p, node)) {
+            return find<next(Axis)>(p, first, middle);
+        }
+        return find<next(Axis)>(p, middle + 1, last);
+    }
+
+    // decrements the live counts on the path to the slot i of the point p
+    template <std::size_t Axis>
+    void uncount(const Point & p, const std::size_t i, const std::size_t first, const std::size_t last)
+    {
+        const std::size_t middle = first + (last - first) / 2;
+        --live[middle];
+        if (last - first <= leaf_size || middle == i) {
+            return;
+        }
+        if (Geometry<Dim, Scalar>::template less<Axis>(p, point(middle))) {
+            uncount<next(Axis)>(p, i, first, middle);
+        }
+        else {
+            uncount<next(Axis)>(p, i, middle + 1, last);
+        }
+    }
+
+    template <std::size_t Axis, class Callback>
+    void range_for_each(const std::size_t first, const std::size_t last, const Box & box, Callback & callback) const
+    {
+        if (last - first <= leaf_size) {
+            if constexpr (planar) {
+                std::uint8_t inside[leaf_size];
+                const std::size_t n = kernels::inside(coords[0] + first, coords[1] + first, last - first, box.min[0], box.min[1], box.max[0], box.max[1], inside);
+                for (std::size_t i = 0; i < n; ++i) {
+                    if (!is_dead(first + inside[i])) {
+                        callback(point(first + inside[i]));
+                    }
+                }
+            }
+            else {
+                for (std::size_t i = first; i < last; ++i) {
+                    if (!is_dead(i) && box.contains(point(i))) {
+                        callback(point(i));
+                    }
+                }
+            }
+            return;
+        }
+        const std::size_t middle = first + (last - first) / 2;
+        const Point node = point(middle);
+        if (!is_dead(middle) && box.contains(node)) {
+            callback(node);
+        }
+        // points sharing the pivot coordinate may lie in both subtrees, hence the non-strict comparisons
+        if (box.min[Axis] <= node[Axis]) {
+            range_for_each<next(Axis)>(first, middle, box, callback);
+        }
+        if (box.max[Axis] >= node[Axis]) {
+            range_for_each<next(Axis)>(middle + 1, last, box, callback);
+        }
+    }
+
+    template <std::size_t Axis>
+    std::size_t range_count(const std::size_t first, const std::size_t last, const Box & box, const Box & region) const
+    {
+        if (first >= last || !box.intersects(region)) {
+            return 0;
+        }
+        const std::size_t middle = first + (last - first) / 2;
+        if (box.contains(region)) {
+            return live[middle];
+        }
+        if (last - first <= leaf_size) {
+            std::size_t count = 0;
+            if constexpr (planar) {
+                std::uint8_t inside[leaf_size];
+                const std::size_t n = kernels::inside(coords[0] + first, coords[1] + first, last - first, box.min[0], box.min[1], box.max[0], box.max[1], inside);
+                for (std::size_t i = 0; i < n; ++i) {
+                    count += is_dead(first + inside[i]) ? 0 : 1;
+                }
+            }
+            else {
+                for (std::size_t i = first; i < last; ++i) {
+                    count += !is_dead(i) && box.contains(point(i)) ? 1 : 0;
+                }
+            }
+            return count;
+        }
+        const Point node = point(middle);
+        std::size_t count = !is_dead(middle) && box.contains(node) ? 1 : 0;
+        Box left = region;
+        left.max[Axis] = node[Axis];
+        Box right = region;
+        right.min[Axis] = node[Axis];
+        count += range_count<next(Axis)>(first, middle, box, left);
+        count += range_count<next(Axis)>(middle + 1, last, box, right);
+        return count;
+    }
+
+    template <std::size_t Axis, class Callback>
+    void within_for_each(const std::size_t first, const std::size_t last, const Point & p, const Scalar r2, Callback & callback) const
+    {
+        if (last - first <= leaf_size) {
+            Scalar distances[leaf_size];
+            squared_distances(first, last, p, distances);
+            for (std::size_t i = 0; i < last - first; ++i) {
+                if (distances[i] <= r2 && !is_dead(first + i)) {
+                    callback(point(first + i));
+                }
+            }
+            return;
+        }
+        const std::size_t middle = first + (last - first) / 2;
+        const Point node = point(middle);
+        if (Geometry<Dim, Scalar>::squared_distance(node, p) <= r2 && !is_dead(middle)) {
+            callback(node);
+        }
+        const Scalar diff = p[Axis] - node[Axis];
+        // squares round monotonically, so a side is never skipped while it holds a point within r
+        if (diff <= 0 || diff * diff <= r2) {
+            within_for_each<next(Axis)>(first, middle, p, r2, callback);
+        }
+        if (diff >= 0 || diff * diff <= r2) {
+            within_for_each<next(Axis)>(middle + 1, last, p, r2, callback);
+        }
+    }
+
+    // squared distances from p to the points of the leaf bucket [first, last)
+    void squared_distances(const std::size_t first, const std::size_t last, const Point & p, Scalar * out) const
+    {
+        if constexpr (planar) {
+            kernels::squared_distances(coords[0] + first, coords[1] + first, last - first, p[0], p[1], out);
+        }
+        else {
+            for (std::size_t i = first; i < last; ++i) {
+                out[i - first] = Geometry<Dim, Scalar>::squared_distance(point(i), p);
+            }
+        }
+    }
+
+    // state of a k nearest search, shrink is (1 + epsilon)^2
+    struct Search
+    {
+        const Point & p;
+        const std::size_t k;
+        const double shrink;
+        BinaryHeap & heap;
+        std::size_t visited;
+    };
+
+    template <std::size_t Axis>
+    void nearest(const std::size_t first, const std::size_t last, Search & search) const
+    {
+        const Point & p = search.p;
+        BinaryHeap & heap = search.heap;
+        ++search.visited;
+        if (last - first <= leaf_size) {
+            Scalar distances[leaf_size];
+            squared_distances(first, last, p, distances);
+            for (std::size_t i = 0; i < last - first; ++i) {
+                if (!is_dead(first + i)) {
+                    offer(heap, search.k, distances[i], first + i);
+                }
+            }
+            return;
+        }
+        const std::size_t middle = first + (last - first) / 2;
+        const Point node = point(middle);
+        if (!is_dead(middle)) {
+            offer(heap, search.k, Geometry<Dim, Scalar>::squared_distance(node, p), middle);
+        }
+        const Scalar diff = p[Axis] - node[Axis];
+        // the other side can hold a candidate only if the splitting plane is closer than the worst one,
+        // the approximate search asks for it to be 1 + epsilon times closer
+        const auto worth = [&] {
+            return heap.size() < search.k || diff * diff * search.shrink <= heap[0].distance;
+        };
+        if (diff < 0) {
+            nearest<next(Axis)>(first, middle, search);
+            if (worth()) {
+                nearest<next(Axis)>(middle + 1, last, search);
+            }
+        }
+        else {
+            nearest<next(Axis)>(middle + 1, last, search);
+            if (worth()) {
+                nearest<next(Axis)>(first, middle, search);
+            }
+        }
+    }
+
+    void offer(BinaryHeap & heap, const std::size_t k, const Scalar distance, const std::size_t i) const
+    {
+        if (heap.size() < k || distance < heap[0].distance) {
+            heap.emplace_back(distance, point(i));
+            std::push_heap(heap.begin(), heap.end());
+            if (heap.size() > k) {
+                std::pop_heap(heap.begin(), heap.end());
+                heap.pop_back();
+            }
+        }
+    }
+
+    // the region of the root, subtree regions are cut from it by the pivots
+    const Box bounds;
+    const std::size_t slots;
+    std::shared_ptr<void> memory;
+    std::size_t offset = 0;
+    // arrays inside the memory block, axis by axis
+    std::array<Scalar *, Dim> coords{};
+    // live points in the subtree, indexed by the position of its node
+    std::uint32_t * live = nullptr;
+    std::uint64_t * dead = nullptr;
+    std::size_t dead_count = 0;
+};
+
+// Dynamic set of Dim-dimensional points built with the logarithmic method: a forest of
+// static trees with sizes decreasing from front to back. A new point becomes a tree of
+// its own and trees are merged while the previous one is not larger than the last one,
+// so every point takes part in O(log N) rebuilds and put costs O(log^2 N) amortized.
+// Erased points stay in their tree as tombstones. Once the dead fraction of a tree
+// exceeds the compaction threshold only that tree is rebuilt, large ones in the
+// background, while queries keep using the old one.
+// E.g. KdTree<3> for (x, y, z), KdTree<4> for (x, y, z, t) or KdTree<2, float> to halve
+// the memory. kdtree::PointSet of primitives.h is KdTree<2, double> for Point and Rect.
+template <std::size_t Dim, class Scalar = double>
+class KdTree
+{
+public:
+    using Tree = StaticTree<Dim, Scalar>;
+    using Point = typename Tree::Point;
+    using Box = typename Tree::Box;
+
+    class iterator
+    {
+    public:
+        using difference_type = std::ptrdiff_t;
+        using value_type = Point;
+        using pointer = const Point *;
+        using reference = const Point &;
+        using iterator_category = std::forward_iterator_tag;
+
+        iterator(const std::shared_ptr<std::vector<Point>> & vector_pointer_, const typename std::vector<Point>::iterator & current_)
+            : current(current_)
+            , vector_pointer(vector_pointer_)
+        {
+        }
+        explicit iterator() = default;
+
+        bool is_valid() const { return vector_pointer != nullptr && current != vector_pointer->end(); }
+
+        reference operator*() const { return *current; }
+
+        pointer operator->() const { return &*current; }
+
+        iterator & operator++()
+        {
+            ++current;
+            return *this;
+        }
+
+        iterator operator++(int)
+        {
+            iterator tmp = *this;
+            ++current;
+            return tmp;
+        }
+
+        bool operator==(const iterator & that) const { return current == that.current; }
+
+        bool operator!=(const iterator & that) const { return !(*this == that); }
+
+    private:
+        typename std::vector<Point>::iterator current;
+        std::shared_ptr<std::vector<Point>> vector_pointer;
+    };
+
+    static constexpr std::size_t dimension = Dim;
+
+    KdTree() = default;
+    // reads Dim whitespace separated coordinates per point, see read_coordinate_file
+    explicit KdTree(const std::string & filename);
+    explicit KdTree(std::vector<Point> points);
+    // adopts built trees with sizes decreasing from front to back, e.g. the ones of a snapshot file
+    explicit KdTree(std::vector<std::shared_ptr<Tree>> forest_);
+    KdTree(const KdTree & that);
+    KdTree(KdTree && that) noexcept;
+    KdTree & operator=(KdTree that);
+    ~KdTree() = default;
+
+    bool empty() const { return count == 0; }
+    std::size_t size() const { return count; }
+    void put(const Point & p);
+    // inserts all the points with a single rebuild instead of one per point
+    void put(std::vector<Point> points);
+    bool erase(const Point & p);
+    bool contains(const Point & p) const;
+
+    // Cheap copy sharing the built trees with this set, a tree is copied only
+    // when either set erases from it. The snapshot never changes unless it is
+    // modified itself, so it may be queried while this set keeps being updated.
+    KdTree snapshot() const;
+
+    double compaction_threshold() const { return threshold; }
+    void set_compaction_threshold(const double threshold_) { threshold = threshold_; }
+    // subtrees with more points than that are built by the shared thread pool
+    std::size_t build_grain() const { return grain; }
+    void set_build_grain(const std::size_t grain_) { grain = grain_; }
+
+    std::pair<iterator, iterator> range(const Box & box) const;
+    // copies the points inside box to out, returns the iterator past the last copied one
+    template <class OutputIt>
+    OutputIt range(const Box & box, OutputIt out) const
+    {
+        range_for_each(box, [&out](const Point & p) {
+            *out++ = p;
+        });
+        return out;
+    }
+    // calls callback for every point inside box, nothing is allocated on the way
+    template <class Callback>
+    void range_for_each(const Box & box, Callback && callback) const
+    {
+        for (const auto & tree : forest) {
+            tree->range_for_each(box, callback);
+        }
+    }
+    std::size_t range_count(const Box & box) const;
+    iterator begin() const;
+    iterator end() const;
+    // calls callback for every point in the order of iteration
+    template <class Callback>
+    void for_each(Callback && callback) const
+    {
+        for (const auto & tree : forest) {
+            tree->for_each(callback);
+        }
+    }
+
+    // points at distance at most r from p
+    std::pair<iterator, iterator> within(const Point & p, Scalar r) const;
+    // copies the points at distance at most r from p to out, returns the iterator past the last copied one
+    template <class OutputIt>
+    OutputIt within(const Point & p, const Scalar r, OutputIt out) const
+    {
+        within_for_each(p, r, [&out](const Point & q) {
+            *out++ = q;
+        });
+        return out;
+    }
+    // calls callback for every point at distance at most r from p, nothing is allocated on the way
+    template <class Callback>
+    void within_for_each(const Point & p, const Scalar r, Callback && callback) const
+    {
+        for (const auto & tree : forest) {
+            tree->within_for_each(p, r, callback);
+        }
+    }
+
+    std::optional<Point> nearest(const Point & p) const;
+    std::pair<iterator, iterator> nearest(const Point & p, std::size_t k) const;
+    // (1 + epsilon)-approximate k nearest: the i-th point returned is at most 1 + epsilon
+    // times farther than the exact i-th neighbour, in exchange far fewer nodes are visited
+    std::pair<iterator, iterator> nearest(const Point & p, std::size_t k, double epsilon) const;
+    // max-heap of the min(k, size()) candidates nearest returns, in the same order
+    typename Tree::BinaryHeap nearest_candidates(const Point & p, std::size_t k, double epsilon = 0) const;
+
+    // the trees of the forest, for the queries that walk them directly
+    const std::vector<std::shared_ptr<Tree>> & trees() const { return forest; }
+
+    friend std::ostream & operator<<(std::ostream & os, const KdTree & tree)
+    {
+        for (const auto & p : tree) {
+            os << "(";
+            for (std::size_t i = 0; i < Dim; ++i) {
+                os << (i == 0 ? "" : ", ") << std::to_string(p[i]);
+            }
+            os << ") ";
+        }
+        return os;
+    }
+
+private:
+    struct Compaction
+    {
+        // keeps the tree the task reads alive
+        std::shared_ptr<const Tree> source;
+        // tree of the forest the result replaces, the source or its copy made by an erase
+        std::weak_ptr<const Tree> target;
+        std::future<Tree> result;
+        // points erased from the source after its tombstones were copied
+        std::vector<Point> erased;
+    };
+
+    // the order of put and of the constructors, (y, x) for two coordinates
+    struct Less
+    {
+        bool operator()(const Point & a, const Point & b) const { return Geometry<Dim, Scalar>::template less<Dim - 1>(a, b); }
+    };
+
+    static void parallel_sort(typename std::vector<Point>::iterator first, typename std::vector<Point>::iterator last, std::size_t grain);
+
+    void assign(std::vector<Point> points);
+    std::shared_ptr<std::vector<Point>> materialize() const;
+    void compact_if_need(const std::shared_ptr<Tree> & tree);
+    void collect_compactions();
+    void replace(const Tree * source, Tree tree);
+    // whether a snapshot holds the tree too
+    bool is_shared(const std::shared_ptr<Tree> & tree) const;
+    void unshare(std::shared_ptr<Tree> & tree);
+    void merge(std::vector<Point> points);
+
+    std::vector<std::shared_ptr<Tree>> forest;
+    std::vector<Compaction> compactions;
+    std::size_t count = 0;
+    double threshold = 0.25;
+    std::size_t grain = 1 << 16;
+    // traversal of the forest tree by tree, it is materialized only when the set is iterated
+    mutable std::shared_ptr<std::vector<Point>> dfs;
+    mutable std::mutex dfs_mutex;
+};
+
+// merge sort over the shared pool, ranges up to grain are sorted sequentially
+template <std::size_t Dim, class Scalar>
+void KdTree<Dim, Scalar>::parallel_sort(const typename std::vector<Point>::iterator first, const typename std::vector<Point>::iterator last, const std::size_t grain)
+{
+    if (static_cast<std::size_t>(last - first) <= grain) {
+        std::sort(first, last, Less());
+        return;
+    }
+    const auto middle = first + (last - first) / 2;
+    ThreadPool::instance().fork_join([&] { parallel_sort(first, middle, grain); },
+                                     [&] { parallel_sort(middle, last, grain); });
+    std::inplace_merge(first, middle, last, Less());
+}
+
+template <std::size_t Dim, class Scalar>
+KdTree<Dim, Scalar>::KdTree(const std::string & filename)
+{
+    if (!filename.empty()) {
+        try {
+            const auto coords = read_coordinates(filename, Dim);
+            std::vector<Point> points(coords.size() / Dim);
+            for (std::size_t i = 0; i < points.size(); ++i) {
+                for (std::size_t axis = 0; axis < Dim; ++axis) {
+                    points[i][axis] = coords[i * Dim + axis];
+                }
+            }
+            assign(std::move(points));
+        }
+        catch (...) {
+            std::cout << "Can't read " << filename << ".\n";
+        }
+    }
+}
+
+template <std::size_t Dim, class Scalar>
+KdTree<Dim, Scalar>::KdTree(std::vector<Point> points)
+{
+    assign(std::move(points));
+}
+
+template <std::size_t Dim, class Scalar>
+KdTree<Dim, Scalar>::KdTree(std::vector<std::shared_ptr<Tree>> forest_)
+    : forest(std::move(forest_))
+{
+    for (const auto & tree : forest) {
+        count += tree->size();
+    }
+}
+
+template <std::size_t Dim, class Scalar>
+void KdTree<Dim, Scalar>::assign(std::vector<Point> points)
+{
+    parallel_sort(points.begin(), points.end(), grain);
+    points.erase(std::unique(points.begin(), points.end()), points.end());
+    count = points.size();
+    if (!points.empty()) {
+        forest.push_back(std::make_shared<Tree>(std::move(points), grain));
+    }
+}
+
+template <std::size_t Dim, class Scalar>
+KdTree<Dim, Scalar>::KdTree(const KdTree & that)
+    : count(that.count)
+    , threshold(that.threshold)
+    , grain(that.grain)
+{
+    {
+        // the traversal is shared if there is one, a copy doesn't materialize it
+        std::lock_guard<std::mutex> lock(that.dfs_mutex);
+        dfs = that.dfs;
+    }
+    // trees carry mutable tombstones, so they can't be shared between sets
+    forest.reserve(that.forest.size());
+    for (const auto & tree : that.forest) {
+        forest.push_back(std::make_shared<Tree>(*tree));
+    }
+}
+
+template <std::size_t Dim, class Scalar>
+KdTree<Dim, Scalar>::KdTree(KdTree && that) noexcept
+    : forest(std::move(that.forest))
+    , compactions(std::move(that.compactions))
+    , count(that.count)
+    , threshold(that.threshold)
+    , grain(that.grain)
+    , dfs(std::move(that.dfs))
+{
+}
+
+template <std::size_t Dim, class Scalar>
+KdTree<Dim, Scalar> & KdTree<Dim, Scalar>::operator=(KdTree that)
+{
+    std::swap(forest, that.forest);
+    std::swap(compactions, that.compactions);
+    std::swap(count, that.count);
+    std::swap(threshold, that.threshold);
+    std::swap(grain, that.grain);
+    std::swap(dfs, that.dfs);
+    return *this;
+}
+
+template <std::size_t Dim, class Scalar>
+void KdTree<Dim, Scalar>::put(const Point & p)
+{
+    collect_compactions();
+    if (contains(p)) {
+        return;
+    }
+    merge({p});
+}
+
+template <std::size_t Dim, class Scalar>
+void KdTree<Dim, Scalar>::put(std::vector<Point> points)
+{
+    collect_compactions();
+    std::sort(points.begin(), points.end(), Less());
+    points.erase(std::unique(points.begin(), points.end()), points.end());
+    points.erase(std::remove_if(points.begin(), points.end(), [this](const Point & p) {
+                     return contains(p);
+                 }),
+                 points.end());
+    if (!points.empty()) {
+        merge(std::move(points));
+    }
+}
+
+// new points become a tree together with all the trees at the back not larger than it
+template <std::size_t Dim, class Scalar>
+void KdTree<Dim, Scalar>::merge(std::vector<Point> points)
+{
+    count += points.size();
+    dfs.reset();
+    while (!forest.empty() && forest.back()->size() <= points.size()) {
+        forest.back()->for_each([&points](const Point & p) {
+            points.push_back(p);
+        });
+        forest.pop_back();
+    }
+    forest.push_back(std::make_shared<Tree>(std::move(points), grain));
+}
+
+template <std::size_t Dim, class Scalar>
+bool KdTree<Dim, Scalar>::erase(const Point & p)
+{
+    collect_compactions();
+    for (auto & tree : forest) {
+        if (is_shared(tree) && tree->contains(p)) {
+            unshare(tree);
+        }
+        if (tree->erase(p)) {
+            --count;
+            dfs.reset();
+            for (auto & compaction : compactions) {
+                if (compaction.target.lock() == tree) {
+                    compaction.erased.push_back(p);
+                }
+            }
+            const auto erased_from = tree;
+            compact_if_need(erased_from);
+            return true;
+        }
+    }
+    return false;
+}
+
+template <std::size_t Dim, class Scalar>
+bool KdTree<Dim, Scalar>::is_shared(const std::shared_ptr<Tree> & tree) const
+{
+    const auto compacting = std::count_if(compactions.begin(), compactions.end(), [&tree](const Compaction & compaction) {
+        return compaction.source == tree;
+    });
+    // the count may drop concurrently when a snapshot is released, then a copy is merely unneeded
+    return tree.use_count() > 1 + compacting;
+}
+
+template <std::size_t Dim, class Scalar>
+void KdTree<Dim, Scalar>::unshare(std::shared_ptr<Tree> & tree)
+{
+    auto copy = std::make_shared<Tree>(*tree);
+    for (auto & compaction : compactions) {
+        if (compaction.target.lock() == tree) {
+            compaction.target = copy;
+        }
+    }
+    tree = std::move(copy);
+}
+
+template <std::size_t Dim, class Scalar>
+KdTree<Dim, Scalar> KdTree<Dim, Scalar>::snapshot() const
+{
+    KdTree result;
+    result.forest = forest;
+    result.count = count;
+    result.threshold = threshold;
+    result.grain = grain;
+    std::lock_guard<std::mutex> lock(dfs_mutex);
+    result.dfs = dfs;
+    return result;
+}
+
+template <std::size_t Dim, class Scalar>
+void KdTree<Dim, Scalar>::compact_if_need(const std::shared_ptr<Tree> & tree)
+{
+    // small trees are cheaper to rebuild in place than to hand over to another thread
+    static constexpr std::size_t background_size = 1 << 16;
+
+    if (tree->dead_fraction() <= threshold) {
+        return;
+    }
+    if (tree->slot_count() < background_size) {
+        replace(tree.get(), Tree(tree->live_points(), grain));
+        return;
+    }
+    const bool running = std::any_of(compactions.begin(), compactions.end(), [&tree](const Compaction & compaction) {
+        return compaction.target.lock() == tree;
+    });
+    if (!running) {
+        // the future is destroyed before the source, so the task may hold a plain pointer
+        auto result = std::async(std::launch::async, [source = tree.get(), tombstones = tree->tombstones(), grain = grain] {
+            return Tree(source->live_points(tombstones), grain);
+        });
+        compactions.push_back({tree, tree, std::move(result), {}});
+    }
+}
+
+template <std::size_t Dim, class Scalar>
+void KdTree<Dim, Scalar>::collect_compactions()
+{
+    auto it = compactions.begin();
+    while (it != compactions.end()) {
+        if (it->result.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            ++it;
+            continue;
+        }
+        Tree tree = it->result.get();
+        for (const auto & p : it->erased) {
+            tree.erase(p);
+        }
+        // the source might have been merged into a larger tree meanwhile, then the result is stale
+        replace(it->target.lock().get(), std::move(tree));
+        it = compactions.erase(it);
+    }
+}
+
+template <std::size_t Dim, class Scalar>
+void KdTree<Dim, Scalar>::replace(const Tree * source, Tree tree)
+{
+    const auto it = std::find_if(forest.begin(), forest.end(), [source](const std::shared_ptr<Tree> & t) {
+        return t.get() == source;
+    });
+    if (it == forest.end()) {
+        return;
+    }
+    if (tree.empty()) {
+        forest.erase(it);
+    }
+    else {
+        *it = std::make_shared<Tree>(std::move(tree));
+    }
+    // keep sizes decreasing for the merges in put
+    std::stable_sort(forest.begin(), forest.end(), [](const std::shared_ptr<Tree> & a, const std::shared_ptr<Tree> & b) {
+        return a->size() > b->size();
+    });
+}
+
+template <std::size_t Dim, class Scalar>
+bool KdTree<Dim, Scalar>::contains(const Point & p) const
+{
+    return std::any_of(forest.begin(), forest.end(), [&p](const std::shared_ptr<Tree> & tree) {
+        return tree->contains(p);
+    });
+}
+
+template <std::size_t Dim, class Scalar>
+typename KdTree<Dim, Scalar>::iterator KdTree<Dim, Scalar>::begin() const
+{
+    const auto traversal = materialize();
+    return iterator(traversal, traversal->begin());
+}
+
+template <std::size_t Dim, class Scalar>
+typename KdTree<Dim, Scalar>::iterator KdTree<Dim, Scalar>::end() const
+{
+    const auto traversal = materialize();
+    return iterator(traversal, traversal->end());
+}
+
+template <std::size_t Dim, class Scalar>
+std::shared_ptr<std::vector<typename KdTree<Dim, Scalar>::Point>> KdTree<Dim, Scalar>::materialize() const
+{
+    std::lock_guard<std::mutex> lock(dfs_mutex);
+    if (dfs == nullptr) {
+        dfs = std::make_shared<std::vector<Point>>();
+        dfs->reserve(count);
+        for_each([this](const Point & p) {
+            dfs->push_back(p);
+        });
+    }
+    return dfs;
+}
+
+template <std::size_t Dim, class Scalar>
+std::pair<typename KdTree<Dim, Scalar>::iterator, typename KdTree<Dim, Scalar>::iterator> KdTree<Dim, Scalar>::range(const Box & box) const
+{
+    auto range_vector = std::make_shared<std::vector<Point>>();
+    range(box, std::back_inserter(*range_vector));
+    return std::make_pair(iterator(range_vector, range_vector->begin()), iterator(range_vector, range_vector->end()));
+}
+
+template <std::size_t Dim, class Scalar>
+std::pair<typename KdTree<Dim, Scalar>::iterator, typename KdTree<Dim, Scalar>::iterator> KdTree<Dim, Scalar>::within(const Point & p, const Scalar r) const
+{
+    auto within_vector = std::make_shared<std::vector<Point>>();
+    within(p, r, std::back_inserter(*within_vector));
+    return std::make_pair(iterator(within_vector, within_vector->begin()), iterator(within_vector, within_vector->end()));
+}
+
+template <std::size_t Dim, class Scalar>
+std::size_t KdTree<Dim, Scalar>::range_count(const Box & box) const
+{
+    std::size_t result = 0;
+    for (const auto & tree : forest) {
+        result += tree->range_count(box);
+    }
+    return result;
+}
+
+template <std::size_t Dim, class Scalar>
+std::optional<typename KdTree<Dim, Scalar>::Point> KdTree<Dim, Scalar>::nearest(const Point & p) const
+{
+    const auto result = nearest(p, 1);
+    if (result.first == result.second) {
+        return std::nullopt;
+    }
+    return *result.first;
+}
+
+template <std::size_t Dim, class Scalar>
+std::pair<typename KdTree<Dim, Scalar>::iterator, typename KdTree<Dim, Scalar>::iterator> KdTree<Dim, Scalar>::nearest(const Point & p, const std::size_t k) const
+{
+    return nearest(p, k, 0);
+}
+
+template <std::size_t Dim, class Scalar>
+std::pair<typename KdTree<Dim, Scalar>::iterator, typename KdTree<Dim, Scalar>::iterator> KdTree<Dim, Scalar>::nearest(const Point & p, const std::size_t k, const double epsilon) const
+{
+    if (empty() || k == 0) {
+        return std::make_pair(end(), end());
+    }
+    if (k >= size()) {
+        return std::make_pair(begin(), end());
+    }
+    const auto heap = nearest_candidates(p, k, epsilon);
+    auto result = std::make_shared<std::vector<Point>>();
+    result->reserve(heap.size());
+    for (const auto & d : heap) {
+        result->push_back(d.point);
+    }
+    return std::make_pair(iterator(result, result->begin()), iterator(result, result->end()));
+}
+
+template <std::size_t Dim, class Scalar>
+typename KdTree<Dim, Scalar>::Tree::BinaryHeap KdTree<Dim, Scalar>::nearest_candidates(const Point & p, const std::size_t k, const double epsilon) const
+{
+    typename Tree::BinaryHeap heap;
+    heap.reserve(k + 1);
+    for (const auto & tree : forest) {
+        tree->nearest(p, k, heap, epsilon);
+    }
+    return heap;
+}
+
+} // namespace kdtree
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Scans of kd-tree leaf buckets stored in struct-of-arrays form. AVX2 versions are
+// used when the CPU supports them, otherwise the portable scalar ones; both give
+// bit-identical results. A bucket holds at most 255 points.
+namespace kdtree::kernels {
+
+// writes offsets of the points inside [xmin, xmax] x [ymin, ymax] to out, returns their number
+std::size_t inside(const double * xs,
+                   const double * ys,
+                   std::size_t n,
+                   double xmin,
+                   double ymin,
+                   double xmax,
+                   double ymax,
+                   std::uint8_t * out);
+
+// squared euclidean distances from (x, y) to the points
+void squared_distances(const double * xs, const double * ys, std::size_t n, double x, double y, double * out);
+
+// name of the selected implementation, "avx2" or "scalar"
+const char * implementation();
+
+} // namespace kdtree::kernels
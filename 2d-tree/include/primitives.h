@@ -1,8 +1,14 @@
 #pragma once
 
+#include "kdtree.h"
+
 #include <algorithm>
 #include <cmath>
+#include <cstdint>
+#include <functional>
+#include <limits>
 #include <memory>
+#include <mutex>
 #include <optional>
 #include <ostream>
 #include <set>
@@ -58,6 +64,7 @@ public:
     double distance(const Point & p) const;
 
     bool contains(const Point & p) const;
+    bool contains(const Rect & rect) const;
     bool intersects(const Rect & rect) const;
 
 private:
@@ -65,6 +72,17 @@ private:
     const Point right_top;
 };
 
+// Points of a text file, every line holds pairs of whitespace separated coordinates,
+// read_coordinate_file of kdtree.h with two coordinates per point.
+struct PointFile
+{
+    std::vector<Point> points;
+    // byte offsets of the lines that couldn't be parsed, ascending, they add no points
+    std::vector<std::size_t> malformed;
+};
+
+PointFile read_point_file(const std::string & filename);
+
 namespace rbtree {
 
 class PointSet
@@ -106,10 +124,36 @@ public:
     bool empty() const;
     std::size_t size() const;
     void put(const Point & p);
+    bool erase(const Point & p);
     bool contains(const Point & p) const;
 
     // second iterator points to an element out of range
     std::pair<iterator, iterator> range(const Rect & rect) const;
+    // copies the points inside rect to out, returns the iterator past the last copied one
+    template <class OutputIt>
+    OutputIt range(const Rect & rect, OutputIt out) const
+    {
+        range_for_each(rect, [&out](const Point & p) {
+            *out++ = p;
+        });
+        return out;
+    }
+    // calls callback for every point inside rect
+    template <class Callback>
+    void range_for_each(const Rect & rect, Callback && callback) const
+    {
+        if (rect.xmin() > rect.xmax() || rect.ymin() > rect.ymax()) {
+            return;
+        }
+        // the set is ordered by (y, x), so the points of the horizontal slab of rect are contiguous
+        const auto last = set_points.upper_bound(Point(rect.xmax(), rect.ymax()));
+        for (auto it = set_points.lower_bound(Point(rect.xmin(), rect.ymin())); it != last; ++it) {
+            if (it->x() >= rect.xmin() && it->x() <= rect.xmax()) {
+                callback(*it);
+            }
+        }
+    }
+    std::size_t range_count(const Rect & rect) const;
     iterator begin() const;
     iterator end() const;
 
@@ -126,6 +170,9 @@ public:
     }
 
 private:
+    // the k nearest points closest first, found going both ways from p in the (y, x) order
+    std::vector<Point> k_nearest(const Point & p, std::size_t k) const;
+
     std::shared_ptr<std::vector<Point>> points;
     std::set<Point> set_points;
 };
@@ -134,44 +181,24 @@ private:
 
 namespace kdtree {
 
-class PointSet
+inline Axis get_axis(const std::size_t depth)
 {
-    struct Node
-    {
-        Node(const Point & p, const Rect & rect_, Axis axis_);
-
-        bool operator<(const Point & that) const;
-        bool operator==(const Point & that) const;
-        bool operator!=(const Point & that) const;
-        bool operator>(const Point & that) const;
-
-        const Point point;
-        const Rect rect;
-        std::shared_ptr<Node> left;
-        std::shared_ptr<Node> right;
-        const Axis axis;
-    };
-
-    struct Distance
-    {
-        Distance(double distance_ = std::numeric_limits<double>::max(), const std::shared_ptr<Node> & node_ = nullptr)
-            : distance(distance_)
-            , node(node_)
-        {
-        }
-
-        bool operator<(const Distance &) const;
-        bool operator>(const Distance &) const;
-        bool operator==(const Distance &) const;
-        bool operator!=(const Distance &) const;
-        bool operator>=(const Distance &) const;
-        bool operator<=(const Distance &) const;
-
-        double distance;
-        std::shared_ptr<Node> node;
-    };
+    if (depth % 2 == 0) {
+        return Axis::X;
+    }
+    return Axis::Y;
+}
 
+// Dynamic set of points of the plane: KdTree<2, double> of kdtree.h, with its forest of
+// static trees, tombstones, background compaction and snapshots, taking Point and Rect.
+// The trees scan their leaf buckets with the SIMD kernels. On top of the template the set
+// has the joins, the batch queries and the snapshot files, which exist for the plane only.
+class PointSet
+{
 public:
+    using Forest = KdTree<2, double>;
+    using Tree = Forest::Tree;
+
     class iterator
     {
     public:
@@ -181,7 +208,7 @@ public:
         using reference = const Point &;
         using iterator_category = std::forward_iterator_tag;
 
-        iterator(const std::shared_ptr<std::vector<std::shared_ptr<Node>>> & vector_pointer_, const std::vector<std::shared_ptr<Node>>::iterator & current_);
+        iterator(const std::shared_ptr<std::vector<Point>> & vector_pointer_, const std::vector<Point>::iterator & current_);
         explicit iterator() = default;
 
         bool is_valid() const;
@@ -199,31 +226,112 @@ public:
         bool operator!=(const iterator &) const;
 
     private:
-        std::vector<std::shared_ptr<Node>>::iterator current;
-        std::shared_ptr<std::vector<std::shared_ptr<Node>>> vector_pointer;
+        std::vector<Point>::iterator current;
+        std::shared_ptr<std::vector<Point>> vector_pointer;
     };
 
     PointSet(const std::string & filename = {});
+    PointSet(const PointSet & that);
+    PointSet(PointSet && that) noexcept;
+    PointSet & operator=(PointSet that);
+    ~PointSet() = default;
 
-    bool empty() const
-    {
-        build_if_need();
-        return points.empty();
-    };
-    std::size_t size() const
-    {
-        build_if_need();
-        return points.size();
-    };
+    bool empty() const { return set.empty(); }
+    std::size_t size() const { return set.size(); }
     void put(const Point & p);
-    bool contains(const Point & p) const;
+    // inserts all the points with a single rebuild instead of one per point
+    void put(const std::vector<Point> & points);
+    bool erase(const Point & p);
+    bool contains(const Point & p) const { return set.contains(to_coordinates(p)); }
+
+    // Cheap copy sharing the built trees with this set, a tree is copied only
+    // when either set erases from it. The snapshot never changes unless it is
+    // modified itself, so it may be queried while this set keeps being updated.
+    PointSet snapshot() const;
+
+    double compaction_threshold() const { return set.compaction_threshold(); }
+    void set_compaction_threshold(const double threshold_) { set.set_compaction_threshold(threshold_); }
+    // subtrees with more points than that are built by the shared thread pool
+    std::size_t build_grain() const { return set.build_grain(); }
+    void set_build_grain(const std::size_t grain_) { set.set_build_grain(grain_); }
 
     std::pair<iterator, iterator> range(const Rect & rect) const;
+    // copies the points inside rect to out, returns the iterator past the last copied one
+    template <class OutputIt>
+    OutputIt range(const Rect & rect, OutputIt out) const
+    {
+        range_for_each(rect, [&out](const Point & p) {
+            *out++ = p;
+        });
+        return out;
+    }
+    // calls callback for every point inside rect, nothing is allocated on the way
+    template <class Callback>
+    void range_for_each(const Rect & rect, Callback && callback) const
+    {
+        set.range_for_each(to_box(rect), [&callback](const Forest::Point & p) {
+            callback(to_point(p));
+        });
+    }
+    std::size_t range_count(const Rect & rect) const { return set.range_count(to_box(rect)); }
     iterator begin() const;
     iterator end() const;
 
+    // points at distance at most r from p
+    std::pair<iterator, iterator> within(const Point & p, double r) const;
+    // copies the points at distance at most r from p to out, returns the iterator past the last copied one
+    template <class OutputIt>
+    OutputIt within(const Point & p, const double r, OutputIt out) const
+    {
+        within_for_each(p, r, [&out](const Point & q) {
+            *out++ = q;
+        });
+        return out;
+    }
+    // calls callback for every point at distance at most r from p, nothing is allocated on the way
+    template <class Callback>
+    void within_for_each(const Point & p, const double r, Callback && callback) const
+    {
+        set.within_for_each(to_coordinates(p), r, [&callback](const Forest::Point & q) {
+            callback(to_point(q));
+        });
+    }
+
     std::optional<Point> nearest(const Point & p) const;
     std::pair<iterator, iterator> nearest(const Point & p, std::size_t k) const;
+    // (1 + epsilon)-approximate k nearest: the i-th point returned is at most 1 + epsilon
+    // times farther than the exact i-th neighbour, in exchange far fewer nodes are visited
+    std::pair<iterator, iterator> nearest(const Point & p, std::size_t k, double epsilon) const;
+
+    // All k nearest neighbours join: calls callback(query, neighbour, distance) for the
+    // min(k, size()) nearest points of this set to every point of queries, closest first.
+    // Up to k = dual_join_k the trees of both sets are walked together and pairs of subtrees
+    // are skipped by the distance between their regions. For larger k the candidates of a
+    // bucket of queries overlap too little for that to pay off (bench/spatial_join measures
+    // the crossover), and every query is searched for on its own in the order of its tree.
+    // In parallel mode subtrees of the query trees are handed out to the shared thread pool
+    // and the callback is called from its threads, the triples of one query are still
+    // delivered together and in order.
+    using JoinCallback = std::function<void(const Point & query, const Point & neighbour, double distance)>;
+    void join(const PointSet & queries, std::size_t k, const JoinCallback & callback, bool parallel = false) const;
+    static constexpr std::size_t dual_join_k = 8;
+
+    // Batch version for n queries: the neighbours of queries[i] are written closest first to
+    // result[i * k, i * k + m), where m = min(k, size()) is returned. The queries are processed
+    // in Hilbert curve order on the shared thread pool, so the result buffer has to hold n * k points.
+    std::size_t nearest(const Point * queries, std::size_t n, std::size_t k, Point * result) const;
+
+    // Binary snapshot of the built trees, tombstones included. load maps the file
+    // privately and checks its structure, queries then run directly on the mapping.
+    // Both throw std::runtime_error on failure.
+    void save(const std::string & path) const;
+    static PointSet load(const std::string & path);
+
+    // conversions to and from the coordinate arrays of the forest
+    static Forest::Point to_coordinates(const Point & p) { return {p.x(), p.y()}; }
+    static Point to_point(const Forest::Point & p) { return Point(p[0], p[1]); }
+    static Forest::Box to_box(const Rect & rect) { return {{rect.xmin(), rect.ymin()}, {rect.xmax(), rect.ymax()}}; }
+    static Rect to_rect(const Forest::Box & box) { return Rect(Point(box.min[0], box.min[1]), Point(box.max[0], box.max[1])); }
 
     friend std::ostream & operator<<(std::ostream & os, const PointSet & tree)
     {
@@ -234,31 +342,14 @@ public:
     }
 
 private:
-    using BinaryHeap = std::vector<Distance>;
-
-    void build() const;
-    std::shared_ptr<Node> build(std::shared_ptr<Node> & node,
-                                std::vector<Point>::iterator first,
-                                std::vector<Point>::iterator last,
-                                const std::vector<Point>::const_iterator & begin,
-                                const Point & min,
-                                const Point & max,
-                                size_t depth) const;
-    void build_if_need() const;
-    void preorder_traversal(const std::shared_ptr<Node> & node) const;
-    std::shared_ptr<Node> search(const std::shared_ptr<Node> & node, const Point & p) const;
-    void range(const std::shared_ptr<Node> & node,
-               const Rect & rect,
-               const std::shared_ptr<std::vector<std::shared_ptr<Node>>> & vector_pointer) const;
-    void nearest(const std::shared_ptr<Node> & node,
-                 const Point & point,
-                 std::size_t k,
-                 BinaryHeap & heap) const;
-
-    mutable std::shared_ptr<Node> root;
-    mutable bool need_build;
-    std::set<Point> points;
-    mutable std::shared_ptr<std::vector<std::shared_ptr<Node>>> dfs;
+    explicit PointSet(Forest set_);
+
+    std::shared_ptr<std::vector<Point>> materialize() const;
+
+    Forest set;
+    // traversal of the forest tree by tree, it is materialized only when the set is iterated
+    mutable std::shared_ptr<std::vector<Point>> dfs;
+    mutable std::mutex dfs_mutex;
 };
 
 } // namespace kdtree
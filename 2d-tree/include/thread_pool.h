@@ -0,0 +1,112 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fork-join pool with work stealing: every worker owns a deque, pushes and pops
+// its own tasks at the back and steals from the front of the others when idle.
+// Threads waiting for a join help with the pending work instead of blocking,
+// so nested fork_join calls can't deadlock the pool.
+class ThreadPool
+{
+public:
+    explicit ThreadPool(std::size_t threads = std::thread::hardware_concurrency());
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool & operator=(const ThreadPool &) = delete;
+    ~ThreadPool();
+
+    // pool shared by the library, has one worker per hardware thread
+    static ThreadPool & instance();
+
+    std::size_t size() const { return workers.size(); }
+
+    // runs both functions, second may be stolen by another worker, returns when both are done
+    template <class First, class Second>
+    void fork_join(First && first, Second && second)
+    {
+        if (workers.empty()) {
+            first();
+            second();
+            return;
+        }
+        Task task(std::forward<Second>(second));
+        push(task);
+        std::exception_ptr error;
+        try {
+            first();
+        }
+        catch (...) {
+            error = std::current_exception();
+        }
+        join(task);
+        if (error == nullptr) {
+            error = task.error;
+        }
+        if (error != nullptr) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    // calls body(first, last) for consecutive chunks of [0, n) no longer than grain
+    template <class Body>
+    void parallel_for(const std::size_t n, const std::size_t grain, Body && body)
+    {
+        parallel_for(0, n, grain == 0 ? 1 : grain, body);
+    }
+
+private:
+    struct Task
+    {
+        template <class F>
+        explicit Task(F && f)
+            : function(std::forward<F>(f))
+        {
+        }
+
+        void run();
+
+        std::function<void()> function;
+        std::exception_ptr error;
+        std::atomic<bool> done{false};
+    };
+
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<Task *> tasks;
+    };
+
+    template <class Body>
+    void parallel_for(const std::size_t first, const std::size_t last, const std::size_t grain, Body & body)
+    {
+        if (last - first <= grain) {
+            body(first, last);
+            return;
+        }
+        const std::size_t middle = first + (last - first) / 2;
+        fork_join([&] { parallel_for(first, middle, grain, body); },
+                  [&] { parallel_for(middle, last, grain, body); });
+    }
+
+    void push(Task & task);
+    void join(Task & task);
+    bool pop_own(const Task & task, std::size_t queue);
+    Task * steal(std::size_t thief);
+    std::size_t current_queue() const;
+    void work(std::size_t index);
+
+    std::vector<std::thread> workers;
+    // one queue per worker and the last one is shared by all outside threads
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::atomic<std::size_t> pending{0};
+    std::atomic<bool> stop{false};
+    std::mutex sleep_mutex;
+    std::condition_variable wake;
+};
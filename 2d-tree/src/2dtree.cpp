@@ -1,24 +1,89 @@
 #include "primitives.h"
 
-#include <fstream>
+#include "thread_pool.h"
+
+#include <cstdint>
 #include <iostream>
+#include <iterator>
 
 namespace {
 
-Axis get_axis(const size_t depth)
+// position of a point on the Hilbert curve filling the 2^16 x 2^16 grid
+std::uint32_t hilbert_index(std::uint32_t x, std::uint32_t y)
 {
-    if (depth % 2 == 0) {
-        return Axis::X;
+    static constexpr std::uint32_t side = 1 << 16;
+
+    std::uint32_t d = 0;
+    for (std::uint32_t s = side / 2; s > 0; s /= 2) {
+        const std::uint32_t rx = (x & s) > 0 ? 1 : 0;
+        const std::uint32_t ry = (y & s) > 0 ? 1 : 0;
+        d += s * s * ((3 * rx) ^ ry);
+        if (ry == 0) {
+            if (rx == 1) {
+                x = side - 1 - x;
+                y = side - 1 - y;
+            }
+            std::swap(x, y);
+        }
     }
-    return Axis::Y;
+    return d;
 }
 
-Point create_point(const Point & p, const Axis axis, const double coord)
+// query indices ordered along the Hilbert curve over the bounding box of the queries,
+// so that consecutive queries descend mostly the same paths of the tree
+std::vector<std::size_t> hilbert_order(const Point * points, const std::size_t n)
 {
-    if (axis == Axis::X) {
-        return Point(coord, p.y());
+    double xmin = std::numeric_limits<double>::max();
+    double ymin = std::numeric_limits<double>::max();
+    double xmax = std::numeric_limits<double>::lowest();
+    double ymax = std::numeric_limits<double>::lowest();
+    for (std::size_t i = 0; i < n; ++i) {
+        if (std::isfinite(points[i].x())) {
+            xmin = std::min(xmin, points[i].x());
+            xmax = std::max(xmax, points[i].x());
+        }
+        if (std::isfinite(points[i].y())) {
+            ymin = std::min(ymin, points[i].y());
+            ymax = std::max(ymax, points[i].y());
+        }
+    }
+    // halves keep the extent finite for any finite bounds; non-finite values land on the border
+    // cells and the result is clamped, since casting NaN or values past the grid is undefined
+    const auto quantize = [](const double value, const double min, const double max) {
+        static constexpr double top = std::numeric_limits<std::uint16_t>::max();
+        if (!(max > min)) {
+            return std::uint32_t{0};
+        }
+        const double cell = (value / 2 - min / 2) / (max / 2 - min / 2) * top;
+        if (!(cell > 0)) {
+            return std::uint32_t{0};
+        }
+        return static_cast<std::uint32_t>(std::min(cell, top));
+    };
+    std::vector<std::pair<std::uint32_t, std::size_t>> keys;
+    keys.reserve(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        keys.emplace_back(hilbert_index(quantize(points[i].x(), xmin, xmax), quantize(points[i].y(), ymin, ymax)), i);
+    }
+    std::sort(keys.begin(), keys.end());
+    std::vector<std::size_t> order;
+    order.reserve(n);
+    for (const auto & key : keys) {
+        order.push_back(key.second);
     }
-    return Point(p.x(), coord);
+    return order;
+}
+
+// points of a file for the rbtree constructor, malformed lines are reported and skipped
+std::vector<Point> read_points(const std::string & filename)
+{
+    const auto coords = read_coordinates(filename, 2);
+    std::vector<Point> points;
+    points.reserve(coords.size() / 2);
+    for (std::size_t i = 0; i + 1 < coords.size(); i += 2) {
+        points.emplace_back(coords[i], coords[i + 1]);
+    }
+    return points;
 }
 
 } // anonymous namespace
@@ -103,6 +168,11 @@ bool Rect::contains(const Point & p) const
     return p.x() >= xmin() && p.x() <= xmax() && p.y() >= ymin() && p.y() <= ymax();
 }
 
+bool Rect::contains(const Rect & r) const
+{
+    return r.xmin() >= xmin() && r.xmax() <= xmax() && r.ymin() >= ymin() && r.ymax() <= ymax();
+}
+
 bool Rect::intersects(const Rect & r) const
 {
     return xmax() >= r.xmin() && ymax() >= r.ymin() && r.xmax() >= xmin() && r.ymax() >= ymin();
@@ -132,6 +202,15 @@ void rbtree::PointSet::put(const Point & p)
     }
 }
 
+bool rbtree::PointSet::erase(const Point & p)
+{
+    if (set_points.erase(p) == 0) {
+        return false;
+    }
+    points->erase(std::find(points->begin(), points->end(), p));
+    return true;
+}
+
 bool rbtree::PointSet::empty() const
 {
     return set_points.empty();
@@ -203,30 +282,27 @@ rbtree::PointSet::iterator rbtree::PointSet::end() const
 
 std::pair<rbtree::PointSet::iterator, rbtree::PointSet::iterator> rbtree::PointSet::range(const Rect & rect) const
 {
-    const auto range = std::make_shared<std::vector<Point>>();
-    for (const auto & p : *this) {
-        if (rect.contains(p)) {
-            range->push_back(p);
-        }
-    }
-    return std::make_pair(iterator(range, range->begin()), iterator(range, range->end()));
+    const auto range_vector = std::make_shared<std::vector<Point>>();
+    range(rect, std::back_inserter(*range_vector));
+    return std::make_pair(iterator(range_vector, range_vector->begin()), iterator(range_vector, range_vector->end()));
+}
+
+std::size_t rbtree::PointSet::range_count(const Rect & rect) const
+{
+    std::size_t count = 0;
+    range_for_each(rect, [&count](const Point &) {
+        ++count;
+    });
+    return count;
 }
 
 std::optional<Point> rbtree::PointSet::nearest(const Point & point) const
 {
-    if (empty()) {
+    const auto result = k_nearest(point, 1);
+    if (result.empty()) {
         return std::nullopt;
     }
-    double min_dist = std::numeric_limits<double>::max();
-    std::optional<Point> min_point;
-    for (const auto & p : *this) {
-        const double dist = p.distance(point);
-        if (dist < min_dist) {
-            min_point.emplace(p);
-            min_dist = dist;
-        }
-    }
-    return min_point;
+    return result.front();
 }
 
 std::pair<rbtree::PointSet::iterator, rbtree::PointSet::iterator> rbtree::PointSet::nearest(const Point & point, const std::size_t k) const
@@ -234,35 +310,52 @@ std::pair<rbtree::PointSet::iterator, rbtree::PointSet::iterator> rbtree::PointS
     if (k >= size()) {
         return std::make_pair(begin(), end());
     }
+    const auto knearest = std::make_shared<std::vector<Point>>(k_nearest(point, k));
+    return std::make_pair(iterator(knearest, knearest->begin()), iterator(knearest, knearest->end()));
+}
+
+std::vector<Point> rbtree::PointSet::k_nearest(const Point & point, const std::size_t k) const
+{
+    // max-heap on squared distance
+    std::vector<std::pair<double, Point>> heap;
     if (k == 0) {
-        return std::make_pair(end(), end());
-    }
-    std::vector<double> distances(size());
-    std::vector<bool> used(size());
-    size_t q = 0;
-    for (const auto & p : *this) {
-        distances[q] = p.distance(point);
-        ++q;
+        return {};
     }
-    const auto knearest = std::make_shared<std::vector<Point>>();
-    knearest->reserve(k);
-    for (size_t i = 0; i < k; ++i) {
-        double min = std::numeric_limits<double>::max();
-        size_t index_min = std::numeric_limits<size_t>::max();
-        auto min_it = end();
-        auto it = begin();
-        for (size_t j = 0; j < size(); ++j) {
-            if (!used[j] && distances[j] < min) {
-                min = distances[j];
-                index_min = j;
-                min_it = it;
+    heap.reserve(k + 1);
+    const auto farther = [](const std::pair<double, Point> & a, const std::pair<double, Point> & b) {
+        return a.first < b.first;
+    };
+    auto up = set_points.lower_bound(point);
+    auto down = up;
+    // the next point is taken from the side with the smaller y gap, so once that gap
+    // alone exceeds the worst candidate nothing closer is left on either side
+    while (up != set_points.end() || down != set_points.begin()) {
+        const double up_gap = up != set_points.end() ? up->y() - point.y() : std::numeric_limits<double>::infinity();
+        const double down_gap = down != set_points.begin() ? point.y() - std::prev(down)->y() : std::numeric_limits<double>::infinity();
+        const double gap = std::min(up_gap, down_gap);
+        if (heap.size() == k && gap * gap > heap.front().first) {
+            break;
+        }
+        const Point & p = up_gap <= down_gap ? *up++ : *--down;
+        const double dx = p.x() - point.x();
+        const double dy = p.y() - point.y();
+        const double distance = dx * dx + dy * dy;
+        if (heap.size() < k || distance < heap.front().first) {
+            heap.emplace_back(distance, p);
+            std::push_heap(heap.begin(), heap.end(), farther);
+            if (heap.size() > k) {
+                std::pop_heap(heap.begin(), heap.end(), farther);
+                heap.pop_back();
             }
-            ++it;
         }
-        knearest->push_back(*min_it);
-        used[index_min] = true;
     }
-    return std::make_pair(iterator(knearest, knearest->begin()), iterator(knearest, knearest->end()));
+    std::sort_heap(heap.begin(), heap.end(), farther);
+    std::vector<Point> result;
+    result.reserve(heap.size());
+    for (const auto & candidate : heap) {
+        result.push_back(candidate.second);
+    }
+    return result;
 }
 
 rbtree::PointSet::PointSet(const std::string & filename)
@@ -270,16 +363,12 @@ rbtree::PointSet::PointSet(const std::string & filename)
 {
     if (!filename.empty()) {
         try {
-            std::ifstream fs(filename);
-
-            double x, y;
-            while (fs) {
-                fs >> x >> y;
-                if (fs.fail()) {
-                    break;
-                }
-                put(Point(x, y));
-            }
+            auto file_points = read_points(filename);
+            std::sort(file_points.begin(), file_points.end());
+            file_points.erase(std::unique(file_points.begin(), file_points.end()), file_points.end());
+            // sorted input goes in at the end hint, so the set is built in linear time
+            set_points.insert(file_points.begin(), file_points.end());
+            *points = std::move(file_points);
         }
         catch (...) {
             std::cerr << "Can't read " << filename << ".\n";
@@ -287,7 +376,7 @@ rbtree::PointSet::PointSet(const std::string & filename)
     }
 }
 
-kdtree::PointSet::iterator::iterator(const std::shared_ptr<std::vector<std::shared_ptr<Node>>> & vector_pointer_, const std::vector<std::shared_ptr<Node>>::iterator & current_)
+kdtree::PointSet::iterator::iterator(const std::shared_ptr<std::vector<Point>> & vector_pointer_, const std::vector<Point>::iterator & current_)
     : current(current_)
     , vector_pointer(vector_pointer_)
 {
@@ -295,12 +384,12 @@ kdtree::PointSet::iterator::iterator(const std::shared_ptr<std::vector<std::shar
 
 kdtree::PointSet::iterator::reference kdtree::PointSet::iterator::operator*() const
 {
-    return (*current)->point;
+    return *current;
 }
 
 kdtree::PointSet::iterator::pointer kdtree::PointSet::iterator::operator->() const
 {
-    return &(*current)->point;
+    return current.operator->();
 }
 
 kdtree::PointSet::iterator & kdtree::PointSet::iterator::operator++()
@@ -331,137 +420,110 @@ bool kdtree::PointSet::iterator::is_valid() const
     return vector_pointer != nullptr && current != vector_pointer->end();
 }
 
-void kdtree::PointSet::put(const Point & p)
+kdtree::PointSet::PointSet(const std::string & filename)
+    : set(filename)
 {
-    need_build = true;
-    points.insert(p);
-}
-
-void kdtree::PointSet::build() const
-{
-    std::vector<Point> c;
-    std::copy(points.begin(), points.end(), std::back_inserter(c));
-    root = build(root,
-                 c.begin(),
-                 c.end(),
-                 c.begin(),
-                 Point(std::numeric_limits<double>::min(),
-                       std::numeric_limits<double>::min()),
-                 Point(std::numeric_limits<double>::max(),
-                       std::numeric_limits<double>::max()),
-                 0);
-    dfs = std::make_shared<std::vector<std::shared_ptr<Node>>>();
-    dfs->reserve(size());
-    preorder_traversal(root);
-}
-
-std::shared_ptr<kdtree::PointSet::Node> kdtree::PointSet::build(std::shared_ptr<Node> & node,
-                                                                const std::vector<Point>::iterator first,
-                                                                const std::vector<Point>::iterator last,
-                                                                const std::vector<Point>::const_iterator & begin,
-                                                                const Point & min,
-                                                                const Point & max,
-                                                                const size_t depth) const
-{
-    if (first >= last || last == begin) {
-        return nullptr;
-    }
-    const Axis axis = get_axis(depth);
-    if (first + 1 == last) {
-        return std::make_shared<Node>(*first, Rect(min, max), axis);
-    }
-    const size_t size = std::distance(first, last);
-    const auto middle = first + size / 2;
-    std::nth_element(first, middle, last, [&axis](const Point & first, const Point & second) {
-        return first.coord(axis) < second.coord(axis);
-    });
-    if (node == nullptr) {
-        node = std::make_shared<Node>(*middle, Rect(min, max), axis);
-    }
-    const double pivot = middle->coord(axis);
-    node->left = build(node->left, first, middle, begin, min, create_point(max, axis, pivot), depth + 1);
-    node->right = build(node->right, middle + 1, last, begin, create_point(min, axis, pivot), max, depth + 1);
-    return node;
 }
 
-void kdtree::PointSet::preorder_traversal(const std::shared_ptr<Node> & node) const
+kdtree::PointSet::PointSet(Forest set_)
+    : set(std::move(set_))
 {
-    if (node != nullptr) {
-        dfs->push_back(node);
-        preorder_traversal(node->left);
-        preorder_traversal(node->right);
-    }
 }
 
-bool kdtree::PointSet::contains(const Point & point) const
+kdtree::PointSet::PointSet(const PointSet & that)
+    : set(that.set)
+    , dfs(that.materialize())
 {
-    build_if_need();
-    return search(root, point) != nullptr;
 }
 
-kdtree::PointSet::iterator kdtree::PointSet::begin() const
+kdtree::PointSet::PointSet(PointSet && that) noexcept
+    : set(std::move(that.set))
+    , dfs(std::move(that.dfs))
 {
-    build_if_need();
-    return iterator(dfs, dfs->begin());
 }
 
-kdtree::PointSet::iterator kdtree::PointSet::end() const
+kdtree::PointSet & kdtree::PointSet::operator=(PointSet that)
 {
-    build_if_need();
-    return iterator(dfs, dfs->end());
+    std::swap(set, that.set);
+    std::swap(dfs, that.dfs);
+    return *this;
 }
 
-void kdtree::PointSet::build_if_need() const
+void kdtree::PointSet::put(const Point & p)
 {
-    if (need_build) {
-        need_build = false;
-        build();
+    const std::size_t before = set.size();
+    set.put(to_coordinates(p));
+    if (set.size() != before) {
+        dfs.reset();
     }
 }
 
-std::shared_ptr<kdtree::PointSet::Node> kdtree::PointSet::search(const std::shared_ptr<Node> & node, const Point & point) const
+void kdtree::PointSet::put(const std::vector<Point> & points)
 {
-    if (node == nullptr) {
-        return nullptr;
+    std::vector<Forest::Point> coords;
+    coords.reserve(points.size());
+    std::transform(points.begin(), points.end(), std::back_inserter(coords), to_coordinates);
+    const std::size_t before = set.size();
+    set.put(std::move(coords));
+    if (set.size() != before) {
+        dfs.reset();
     }
-    if (*node == point) {
-        return node;
+}
+
+bool kdtree::PointSet::erase(const Point & p)
+{
+    if (!set.erase(to_coordinates(p))) {
+        return false;
     }
-    if (*node > point) {
-        return search(node->left, point);
+    dfs.reset();
+    return true;
+}
+
+kdtree::PointSet kdtree::PointSet::snapshot() const
+{
+    PointSet result(set.snapshot());
+    std::lock_guard<std::mutex> lock(dfs_mutex);
+    result.dfs = dfs;
+    return result;
+}
+
+kdtree::PointSet::iterator kdtree::PointSet::begin() const
+{
+    const auto traversal = materialize();
+    return iterator(traversal, traversal->begin());
+}
+
+kdtree::PointSet::iterator kdtree::PointSet::end() const
+{
+    const auto traversal = materialize();
+    return iterator(traversal, traversal->end());
+}
+
+std::shared_ptr<std::vector<Point>> kdtree::PointSet::materialize() const
+{
+    std::lock_guard<std::mutex> lock(dfs_mutex);
+    if (dfs == nullptr) {
+        dfs = std::make_shared<std::vector<Point>>();
+        dfs->reserve(set.size());
+        set.for_each([this](const Forest::Point & p) {
+            dfs->push_back(to_point(p));
+        });
     }
-    return search(node->right, point);
+    return dfs;
 }
 
-std::pair<kdtree::PointSet::iterator, kdtree::PointSet::iterator> kdtree::PointSet::range(const Rect & r) const
+std::pair<kdtree::PointSet::iterator, kdtree::PointSet::iterator> kdtree::PointSet::range(const Rect & rect) const
 {
-    build_if_need();
-    auto range_vector = std::make_shared<std::vector<std::shared_ptr<Node>>>();
-    range(root, r, range_vector);
+    auto range_vector = std::make_shared<std::vector<Point>>();
+    range(rect, std::back_inserter(*range_vector));
     return std::make_pair(iterator(range_vector, range_vector->begin()), iterator(range_vector, range_vector->end()));
 }
 
-void kdtree::PointSet::range(const std::shared_ptr<Node> & node, const Rect & rect, const std::shared_ptr<std::vector<std::shared_ptr<Node>>> & r) const
+std::pair<kdtree::PointSet::iterator, kdtree::PointSet::iterator> kdtree::PointSet::within(const Point & p, const double r) const
 {
-    if (node != nullptr && rect.intersects(node->rect)) {
-        if (rect.contains(node->point)) {
-            r->push_back(node);
-        }
-        const Axis axis = node->axis;
-        const double point_coord = node->point.coord(axis);
-        const double min_coord = rect.min_coord(axis);
-        const double max_coord = rect.max_coord(axis);
-        if (max_coord >= point_coord && min_coord <= point_coord) {
-            range(node->left, rect, r);
-            range(node->right, rect, r);
-        }
-        else if (max_coord <= point_coord) {
-            range(node->left, rect, r);
-        }
-        else if (min_coord >= point_coord) {
-            range(node->right, rect, r);
-        }
-    }
+    auto within_vector = std::make_shared<std::vector<Point>>();
+    within(p, r, std::back_inserter(*within_vector));
+    return std::make_pair(iterator(within_vector, within_vector->begin()), iterator(within_vector, within_vector->end()));
 }
 
 std::optional<Point> kdtree::PointSet::nearest(const Point & p) const
@@ -473,143 +535,53 @@ std::optional<Point> kdtree::PointSet::nearest(const Point & p) const
     return *result.first;
 }
 
-std::pair<kdtree::PointSet::iterator, kdtree::PointSet::iterator> kdtree::PointSet::nearest(const Point & point, const std::size_t k) const
+std::pair<kdtree::PointSet::iterator, kdtree::PointSet::iterator> kdtree::PointSet::nearest(const Point & p, const std::size_t k) const
+{
+    return nearest(p, k, 0);
+}
+
+std::pair<kdtree::PointSet::iterator, kdtree::PointSet::iterator> kdtree::PointSet::nearest(const Point & p, const std::size_t k, const double epsilon) const
 {
-    build_if_need();
     if (empty() || k == 0) {
         return std::make_pair(end(), end());
     }
     if (k >= size()) {
         return std::make_pair(begin(), end());
     }
-    BinaryHeap heap;
-    std::make_heap(heap.begin(), heap.end());
-    heap.reserve(k + 1);
-    nearest(root, point, k, heap);
-    auto result = std::make_shared<std::vector<std::shared_ptr<Node>>>();
+    const auto heap = set.nearest_candidates(to_coordinates(p), k, epsilon);
+    auto result = std::make_shared<std::vector<Point>>();
     result->reserve(heap.size());
     for (const auto & d : heap) {
-        result->push_back(d.node);
+        result->push_back(to_point(d.point));
     }
     return std::make_pair(iterator(result, result->begin()), iterator(result, result->end()));
 }
 
-void kdtree::PointSet::nearest(const std::shared_ptr<Node> & node, const Point & point, const std::size_t k, BinaryHeap & heap) const
+std::size_t kdtree::PointSet::nearest(const Point * queries, const std::size_t n, const std::size_t k, Point * result) const
 {
-    if (node == nullptr) {
-        return;
-    }
-    const double dist = point.distance(node->point);
-    if (heap.size() < k || dist < heap[0].distance) {
-        heap.emplace_back(dist, node);
-        std::push_heap(heap.begin(), heap.end());
-        if (heap.size() > k) {
-            std::pop_heap(heap.begin(), heap.end());
-            heap.pop_back();
-        }
-    }
-    const double coord = point.coord(node->axis);
-    const double pivot = node->point.coord(node->axis);
-    if (coord < pivot) {
-        nearest(node->left, point, k, heap);
-        if (coord + heap[0].distance >= pivot) {
-            nearest(node->right, point, k, heap);
-        }
-    }
-    else {
-        nearest(node->right, point, k, heap);
-        if (coord - heap[0].distance <= pivot) {
-            nearest(node->left, point, k, heap);
-        }
-    }
-}
+    // queries per task of the thread pool
+    static constexpr std::size_t batch_grain = 256;
 
-kdtree::PointSet::PointSet(const std::string & filename)
-    : need_build(true)
-{
-    if (!filename.empty()) {
-        try {
-            std::ifstream fs(filename);
-
-            double x, y;
-            while (fs) {
-                fs >> x >> y;
-                if (fs.fail()) {
-                    break;
-                }
-                points.emplace(x, y);
-            }
-
-            build_if_need();
-        }
-        catch (...) {
-            std::cout << "Can't read " << filename << ".\n";
-        }
+    const std::size_t m = std::min(k, size());
+    if (n == 0 || m == 0) {
+        return m;
     }
-}
-
-kdtree::PointSet::Node::Node(const Point & p, const Rect & rect_, const Axis axis_)
-    : point(p)
-    , rect(rect_)
-    , axis(axis_)
-{
-}
-
-bool kdtree::PointSet::Node::operator>(const Point & p) const
-{
-    if (axis == Axis::X) {
-        if (point.x() == p.x()) {
-            return point.y() > p.y();
+    const auto order = hilbert_order(queries, n);
+    const auto & forest = set.trees();
+    ThreadPool::instance().parallel_for(n, batch_grain, [&](const std::size_t first, const std::size_t last) {
+        thread_local Tree::BinaryHeap heap;
+        heap.reserve(m + 1);
+        for (std::size_t i = first; i < last; ++i) {
+            const std::size_t q = order[i];
+            heap.clear();
+            for (const auto & tree : forest) {
+                tree->nearest(to_coordinates(queries[q]), m, heap);
+            }
+            std::sort_heap(heap.begin(), heap.end());
+            std::transform(heap.begin(), heap.end(), result + q * k, [](const Tree::Distance & d) {
+                return to_point(d.point);
+            });
         }
-        return point.x() > p.x();
-    }
-    if (point.y() == p.y()) {
-        return point.x() > p.x();
-    }
-    return point.y() > p.y();
-}
-
-bool kdtree::PointSet::Node::operator<(const Point & p) const
-{
-    return !(*this > p) && *this != p;
-}
-
-bool kdtree::PointSet::Node::operator==(const Point & p) const
-{
-    return point == p;
-}
-
-bool kdtree::PointSet::Node::operator!=(const Point & p) const
-{
-    return !(*this == p);
-}
-
-bool kdtree::PointSet::Distance::operator<(const kdtree::PointSet::Distance & that) const
-{
-    return distance < that.distance;
-}
-
-bool kdtree::PointSet::Distance::operator>(const kdtree::PointSet::Distance & that) const
-{
-    return distance > that.distance;
-}
-
-bool kdtree::PointSet::Distance::operator==(const kdtree::PointSet::Distance & that) const
-{
-    return distance == that.distance;
-}
-
-bool kdtree::PointSet::Distance::operator!=(const kdtree::PointSet::Distance & that) const
-{
-    return !(*this == that);
-}
-
-bool kdtree::PointSet::Distance::operator>=(const kdtree::PointSet::Distance & that) const
-{
-    return !(*this < that);
-}
-
-bool kdtree::PointSet::Distance::operator<=(const kdtree::PointSet::Distance & that) const
-{
-    return !(*this > that);
+    });
+    return m;
 }
@@ -0,0 +1,100 @@
+#include "concurrent_point_set.h"
+
+kdtree::ConcurrentPointSet::ConcurrentPointSet(PointSet points)
+    : set(std::move(points))
+{
+    publish(set);
+    worker = std::thread([this] { run(); });
+}
+
+kdtree::ConcurrentPointSet::~ConcurrentPointSet()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+    }
+    queued_changes.notify_one();
+    worker.join();
+}
+
+std::shared_ptr<const kdtree::PointSet> kdtree::ConcurrentPointSet::snapshot() const
+{
+    return std::atomic_load(&published);
+}
+
+void kdtree::ConcurrentPointSet::put(const Point & p)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.push_back({p, false});
+        ++queued;
+    }
+    queued_changes.notify_one();
+}
+
+void kdtree::ConcurrentPointSet::erase(const Point & p)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.push_back({p, true});
+        ++queued;
+    }
+    queued_changes.notify_one();
+}
+
+void kdtree::ConcurrentPointSet::flush()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    const std::uint64_t target = queued;
+    published_changes.wait(lock, [this, target] { return applied >= target; });
+}
+
+void kdtree::ConcurrentPointSet::publish(const PointSet & points)
+{
+    std::atomic_store(&published, std::shared_ptr<const PointSet>(std::make_shared<PointSet>(points.snapshot())));
+}
+
+// runs of puts are inserted together, erases keep their place in the order
+void kdtree::ConcurrentPointSet::apply(std::vector<Change> & batch)
+{
+    std::vector<Point> puts;
+    for (const auto & change : batch) {
+        if (!change.erase) {
+            puts.push_back(change.point);
+            continue;
+        }
+        if (!puts.empty()) {
+            set.put(std::move(puts));
+            puts.clear();
+        }
+        set.erase(change.point);
+    }
+    if (!puts.empty()) {
+        set.put(std::move(puts));
+    }
+    batch.clear();
+}
+
+void kdtree::ConcurrentPointSet::run()
+{
+    std::vector<Change> batch;
+    while (true) {
+        std::uint64_t target;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            queued_changes.wait(lock, [this] { return stop || !queue.empty(); });
+            if (queue.empty()) {
+                return;
+            }
+            batch.swap(queue);
+            target = queued;
+        }
+        apply(batch);
+        publish(set);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            applied = target;
+        }
+        published_changes.notify_all();
+    }
+}
@@ -0,0 +1,354 @@
+#include "primitives.h"
+
+#include "thread_pool.h"
+
+#include <cmath>
+
+namespace kdtree {
+
+namespace {
+
+using Tree = PointSet::Tree;
+using Box = Tree::Box;
+
+// queries handled at once, their candidate heaps take chunk_size * k entries
+constexpr std::size_t chunk_size = 1 << 12;
+
+constexpr double infinity = std::numeric_limits<double>::infinity();
+
+double squared_gap(const Box & a, const Box & b)
+{
+    const double dx = std::max({0.0, a.min[0] - b.max[0], b.min[0] - a.max[0]});
+    const double dy = std::max({0.0, a.min[1] - b.max[1], b.min[1] - a.max[1]});
+    return dx * dx + dy * dy;
+}
+
+double squared_gap(const Box & a, const double x, const double y)
+{
+    const double dx = std::max({0.0, a.min[0] - x, x - a.max[0]});
+    const double dy = std::max({0.0, a.min[1] - y, y - a.max[1]});
+    return dx * dx + dy * dy;
+}
+
+// regions of the subtrees of a node, cut by its pivot
+std::pair<Box, Box> split(const Box & region, const std::size_t axis, const double pivot)
+{
+    std::pair<Box, Box> result(region, region);
+    result.first.max[axis] = pivot;
+    result.second.min[axis] = pivot;
+    return result;
+}
+
+} // anonymous namespace
+
+// Dual-tree all k nearest join of one query tree against the reference forest.
+// Points live in internal nodes too, so the query tree is descended first: a query
+// subtree is skipped against a reference tree when its region is farther than the
+// worst candidate of all its queries, a node point is searched for on its own and
+// a leaf bucket walks the reference tree as a group. The bucket is pruned against
+// reference subtrees by the distance between its bounding box and their regions,
+// and a reference point met on the way is offered to the whole bucket at once.
+// Every query keeps its k-th squared distance next to its heap, so a candidate is
+// rejected with a single comparison and the bound of the bucket is recomputed only
+// when one of its heaps changes.
+// Above PointSet::dual_join_k the walk costs more than it saves, then the queries of a
+// chunk are searched for one by one in the order of the query tree, which still keeps
+// the reference nodes they visit in cache.
+class Join
+{
+public:
+    Join(const Tree & queries_, const std::vector<std::shared_ptr<Tree>> & references_, const std::size_t k_, const PointSet::JoinCallback & callback_)
+        : queries(queries_)
+        , references(references_)
+        , k(k_)
+        , callback(callback_)
+    {
+    }
+
+    void run(const bool parallel)
+    {
+        partition(0, queries.slots, 0, queries.region(), parallel);
+    }
+
+private:
+    // candidates of a contiguous range of query slots
+    struct Chunk
+    {
+        Chunk(const std::size_t first_, const std::size_t last_, const std::size_t k, const Tree & queries)
+            : first(first_)
+            , heaps((last_ - first_) * k, Tree::Distance(0, {0, 0}))
+            , sizes(last_ - first_)
+            , kth(last_ - first_, infinity)
+            , bounds(last_ - first_, infinity)
+        {
+            // a dead query takes no candidates and doesn't loosen any bound
+            for (std::size_t i = first_; i < last_; ++i) {
+                if (queries.is_dead(i)) {
+                    kth[i - first] = 0;
+                }
+            }
+        }
+
+        std::size_t first;
+        // max-heaps of k entries, one per query
+        std::vector<Tree::Distance> heaps;
+        std::vector<std::size_t> sizes;
+        // top of every heap, infinite while it holds less than k entries
+        std::vector<double> kth;
+        // worst squared distance over the queries of the subtree, indexed by the position of its node
+        std::vector<double> bounds;
+    };
+
+    void partition(const std::size_t first, const std::size_t last, const std::size_t depth, const Box & region, const bool parallel)
+    {
+        if (first >= last) {
+            return;
+        }
+        if (last - first <= chunk_size) {
+            if (k > PointSet::dual_join_k) {
+                search(first, last);
+                return;
+            }
+            Chunk chunk(first, last, k, queries);
+            for (const auto & reference : references) {
+                descend(chunk, first, last, depth, region, *reference);
+            }
+            emit(chunk, first, last);
+            return;
+        }
+        const std::size_t middle = first + (last - first) / 2;
+        if (k > PointSet::dual_join_k) {
+            search(middle, middle + 1);
+        }
+        else if (!queries.is_dead(middle)) {
+            Chunk chunk(middle, middle + 1, k, queries);
+            for (const auto & reference : references) {
+                scan(chunk, middle, middle + 1, reference->region(), *reference);
+            }
+            emit(chunk, middle, middle + 1);
+        }
+        const std::size_t axis = depth % 2;
+        const auto [left, right] = split(region, axis, queries.coords[axis][middle]);
+        if (parallel) {
+            ThreadPool::instance().fork_join([&, left = left] { partition(first, middle, depth + 1, left, true); },
+                                             [&, right = right] { partition(middle + 1, last, depth + 1, right, true); });
+        }
+        else {
+            partition(first, middle, depth + 1, left, false);
+            partition(middle + 1, last, depth + 1, right, false);
+        }
+    }
+
+    // the live queries of [first, last) one by one
+    void search(const std::size_t first, const std::size_t last) const
+    {
+        Tree::BinaryHeap heap;
+        heap.reserve(k + 1);
+        for (std::size_t i = first; i < last; ++i) {
+            if (queries.is_dead(i)) {
+                continue;
+            }
+            heap.clear();
+            for (const auto & reference : references) {
+                reference->nearest(queries.point(i), k, heap);
+            }
+            // for large k introsort mispredicts less than popping the heap one by one
+            std::sort(heap.begin(), heap.end());
+            const Point query = PointSet::to_point(queries.point(i));
+            for (const auto & d : heap) {
+                callback(query, PointSet::to_point(d.point), std::sqrt(d.distance));
+            }
+        }
+    }
+
+    void descend(Chunk & chunk, const std::size_t first, const std::size_t last, const std::size_t depth, const Box & region, const Tree & reference)
+    {
+        if (first >= last) {
+            return;
+        }
+        const std::size_t middle = first + (last - first) / 2;
+        double & bound = chunk.bounds[middle - chunk.first];
+        if (squared_gap(region, reference.region()) > bound) {
+            return;
+        }
+        if (last - first <= Tree::leaf_size) {
+            scan(chunk, first, last, reference.region(), reference);
+            bound = worst(chunk, first, last);
+            return;
+        }
+        if (!queries.is_dead(middle)) {
+            scan(chunk, middle, middle + 1, reference.region(), reference);
+        }
+        const std::size_t axis = depth % 2;
+        const auto [left, right] = split(region, axis, queries.coords[axis][middle]);
+        descend(chunk, first, middle, depth + 1, left, reference);
+        descend(chunk, middle + 1, last, depth + 1, right, reference);
+        bound = std::max({worst(chunk, middle, middle + 1), subtree_bound(chunk, first, middle), subtree_bound(chunk, middle + 1, last)});
+    }
+
+    double subtree_bound(const Chunk & chunk, const std::size_t first, const std::size_t last) const
+    {
+        if (first >= last) {
+            return 0;
+        }
+        return chunk.bounds[first + (last - first) / 2 - chunk.first];
+    }
+
+    // worst candidate over the live queries of [first, last), infinite while one of them has less than k
+    static double worst(const Chunk & chunk, const std::size_t first, const std::size_t last)
+    {
+        const auto kth = chunk.kth.begin() + static_cast<std::ptrdiff_t>(first - chunk.first);
+        return *std::max_element(kth, kth + static_cast<std::ptrdiff_t>(last - first));
+    }
+
+    // whether a candidate at that squared distance may enter a heap with the given top
+    static bool wanted(const double distance, const double kth)
+    {
+        return distance < kth || kth == infinity;
+    }
+
+    // the queries of [first, last) against a whole reference tree
+    void scan(Chunk & chunk, const std::size_t first, const std::size_t last, const Box & region, const Tree & reference)
+    {
+        Box box{{infinity, infinity}, {-infinity, -infinity}};
+        for (std::size_t i = first; i < last; ++i) {
+            if (!queries.is_dead(i)) {
+                for (std::size_t axis = 0; axis < 2; ++axis) {
+                    box.min[axis] = std::min(box.min[axis], queries.coords[axis][i]);
+                    box.max[axis] = std::max(box.max[axis], queries.coords[axis][i]);
+                }
+            }
+        }
+        if (box.min[0] > box.max[0]) {
+            return;
+        }
+        double bound = worst(chunk, first, last);
+        scan(chunk, first, last, box, bound, reference, 0, reference.slots, 0, region);
+    }
+
+    void scan(Chunk & chunk,
+              const std::size_t first,
+              const std::size_t last,
+              const Box & box,
+              double & bound,
+              const Tree & reference,
+              const std::size_t reference_first,
+              const std::size_t reference_last,
+              const std::size_t depth,
+              const Box & region)
+    {
+        if (reference_first >= reference_last || squared_gap(box, region) > bound) {
+            return;
+        }
+        const double * xs = queries.coords[0];
+        const double * ys = queries.coords[1];
+        const double * kth = chunk.kth.data() - chunk.first;
+        double distances[Tree::leaf_size];
+        bool changed = false;
+        if (reference_last - reference_first <= Tree::leaf_size) {
+            const std::size_t n = reference_last - reference_first;
+            for (std::size_t i = first; i < last; ++i) {
+                // the bucket as a whole reaches the leaf, a single query often doesn't
+                if (squared_gap(region, xs[i], ys[i]) > kth[i]) {
+                    continue;
+                }
+                kernels::squared_distances(reference.coords[0] + reference_first, reference.coords[1] + reference_first, n, xs[i], ys[i], distances);
+                for (std::size_t j = 0; j < n; ++j) {
+                    if (wanted(distances[j], kth[i]) && !reference.is_dead(reference_first + j)) {
+                        changed |= offer(chunk, i, distances[j], reference_first + j, reference);
+                    }
+                }
+            }
+            if (changed) {
+                bound = worst(chunk, first, last);
+            }
+            return;
+        }
+        const std::size_t middle = reference_first + (reference_last - reference_first) / 2;
+        const double x = reference.coords[0][middle];
+        const double y = reference.coords[1][middle];
+        if (!reference.is_dead(middle) && squared_gap(box, x, y) <= bound) {
+            kernels::squared_distances(xs + first, ys + first, last - first, x, y, distances);
+            for (std::size_t i = first; i < last; ++i) {
+                if (wanted(distances[i - first], kth[i])) {
+                    changed |= offer(chunk, i, distances[i - first], middle, reference);
+                }
+            }
+            if (changed) {
+                bound = worst(chunk, first, last);
+            }
+        }
+        const std::size_t axis = depth % 2;
+        const double pivot = reference.coords[axis][middle];
+        const auto [left, right] = split(region, axis, pivot);
+        // the nearer side first, it tightens the bound for the other one; when the box
+        // straddles the pivot its centre decides
+        const double left_gap = squared_gap(box, left);
+        const double right_gap = squared_gap(box, right);
+        const double centre = (box.min[axis] + box.max[axis]) / 2;
+        if (left_gap < right_gap || (left_gap == right_gap && centre < pivot)) {
+            scan(chunk, first, last, box, bound, reference, reference_first, middle, depth + 1, left);
+            scan(chunk, first, last, box, bound, reference, middle + 1, reference_last, depth + 1, right);
+        }
+        else {
+            scan(chunk, first, last, box, bound, reference, middle + 1, reference_last, depth + 1, right);
+            scan(chunk, first, last, box, bound, reference, reference_first, middle, depth + 1, left);
+        }
+    }
+
+    // returns whether the heap of the query took the candidate
+    bool offer(Chunk & chunk, const std::size_t query, const double distance, const std::size_t i, const Tree & reference) const
+    {
+        const std::size_t j = query - chunk.first;
+        Tree::Distance * heap = chunk.heaps.data() + j * k;
+        std::size_t & size = chunk.sizes[j];
+        if (size < k) {
+            heap[size++] = Tree::Distance(distance, reference.point(i));
+            std::push_heap(heap, heap + size);
+        }
+        else if (distance < heap[0].distance) {
+            std::pop_heap(heap, heap + size);
+            heap[size - 1] = Tree::Distance(distance, reference.point(i));
+            std::push_heap(heap, heap + size);
+        }
+        else {
+            return false;
+        }
+        chunk.kth[j] = size < k ? infinity : heap[0].distance;
+        return true;
+    }
+
+    void emit(Chunk & chunk, const std::size_t first, const std::size_t last) const
+    {
+        for (std::size_t i = first; i < last; ++i) {
+            if (queries.is_dead(i)) {
+                continue;
+            }
+            const std::size_t j = i - chunk.first;
+            Tree::Distance * heap = chunk.heaps.data() + j * k;
+            std::sort_heap(heap, heap + chunk.sizes[j]);
+            const Point query = PointSet::to_point(queries.point(i));
+            for (std::size_t n = 0; n < chunk.sizes[j]; ++n) {
+                callback(query, PointSet::to_point(heap[n].point), std::sqrt(heap[n].distance));
+            }
+        }
+    }
+
+    const Tree & queries;
+    const std::vector<std::shared_ptr<Tree>> & references;
+    const std::size_t k;
+    const PointSet::JoinCallback & callback;
+};
+
+} // namespace kdtree
+
+void kdtree::PointSet::join(const PointSet & queries, const std::size_t k, const JoinCallback & callback, const bool parallel) const
+{
+    const std::size_t m = std::min(k, size());
+    if (m == 0) {
+        return;
+    }
+    for (const auto & tree : queries.set.trees()) {
+        Join(*tree, set.trees(), m, callback).run(parallel);
+    }
+}
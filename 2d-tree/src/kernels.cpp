@@ -0,0 +1,134 @@
+#include "kernels.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define KDTREE_HAS_AVX2_KERNELS
+#endif
+
+namespace {
+
+std::size_t inside_scalar(const double * xs,
+                          const double * ys,
+                          const std::size_t n,
+                          const double xmin,
+                          const double ymin,
+                          const double xmax,
+                          const double ymax,
+                          std::uint8_t * out)
+{
+    std::size_t count = 0;
+    for (std::size_t i = 0; i < n; ++i) {
+        out[count] = static_cast<std::uint8_t>(i);
+        count += xs[i] >= xmin && xs[i] <= xmax && ys[i] >= ymin && ys[i] <= ymax ? 1 : 0;
+    }
+    return count;
+}
+
+void squared_distances_scalar(const double * xs, const double * ys, const std::size_t n, const double x, const double y, double * out)
+{
+    for (std::size_t i = 0; i < n; ++i) {
+        const double dx = xs[i] - x;
+        const double dy = ys[i] - y;
+        out[i] = dx * dx + dy * dy;
+    }
+}
+
+#ifdef KDTREE_HAS_AVX2_KERNELS
+
+__attribute__((target("avx2"))) std::size_t inside_avx2(const double * xs,
+                                                        const double * ys,
+                                                        const std::size_t n,
+                                                        const double xmin,
+                                                        const double ymin,
+                                                        const double xmax,
+                                                        const double ymax,
+                                                        std::uint8_t * out)
+{
+    const __m256d x0 = _mm256_set1_pd(xmin);
+    const __m256d y0 = _mm256_set1_pd(ymin);
+    const __m256d x1 = _mm256_set1_pd(xmax);
+    const __m256d y1 = _mm256_set1_pd(ymax);
+    std::size_t count = 0;
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        const __m256d x = _mm256_loadu_pd(xs + i);
+        const __m256d y = _mm256_loadu_pd(ys + i);
+        const __m256d in_x = _mm256_and_pd(_mm256_cmp_pd(x, x0, _CMP_GE_OQ), _mm256_cmp_pd(x, x1, _CMP_LE_OQ));
+        const __m256d in_y = _mm256_and_pd(_mm256_cmp_pd(y, y0, _CMP_GE_OQ), _mm256_cmp_pd(y, y1, _CMP_LE_OQ));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_pd(_mm256_and_pd(in_x, in_y)));
+        while (mask != 0) {
+            out[count++] = static_cast<std::uint8_t>(i + __builtin_ctz(mask));
+            mask &= mask - 1;
+        }
+    }
+    // the tail is shorter than a vector, offsets of the scalar version start from it
+    const std::size_t tail = inside_scalar(xs + i, ys + i, n - i, xmin, ymin, xmax, ymax, out + count);
+    for (std::size_t j = count; j < count + tail; ++j) {
+        out[j] = static_cast<std::uint8_t>(out[j] + i);
+    }
+    return count + tail;
+}
+
+__attribute__((target("avx2"))) void squared_distances_avx2(const double * xs, const double * ys, const std::size_t n, const double x, const double y, double * out)
+{
+    const __m256d px = _mm256_set1_pd(x);
+    const __m256d py = _mm256_set1_pd(y);
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        const __m256d dx = _mm256_sub_pd(_mm256_loadu_pd(xs + i), px);
+        const __m256d dy = _mm256_sub_pd(_mm256_loadu_pd(ys + i), py);
+        // no fused multiply-add, so the result matches the scalar version bit for bit
+        _mm256_storeu_pd(out + i, _mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy)));
+    }
+    squared_distances_scalar(xs + i, ys + i, n - i, x, y, out + i);
+}
+
+#endif
+
+struct Kernels
+{
+    Kernels()
+    {
+#ifdef KDTREE_HAS_AVX2_KERNELS
+        if (__builtin_cpu_supports("avx2")) {
+            inside = inside_avx2;
+            squared_distances = squared_distances_avx2;
+            name = "avx2";
+        }
+#endif
+    }
+
+    decltype(&inside_scalar) inside = inside_scalar;
+    decltype(&squared_distances_scalar) squared_distances = squared_distances_scalar;
+    const char * name = "scalar";
+};
+
+const Kernels & selected()
+{
+    static const Kernels kernels;
+    return kernels;
+}
+
+} // anonymous namespace
+
+std::size_t kdtree::kernels::inside(const double * xs,
+                                    const double * ys,
+                                    const std::size_t n,
+                                    const double xmin,
+                                    const double ymin,
+                                    const double xmax,
+                                    const double ymax,
+                                    std::uint8_t * out)
+{
+    return selected().inside(xs, ys, n, xmin, ymin, xmax, ymax, out);
+}
+
+void kdtree::kernels::squared_distances(const double * xs, const double * ys, const std::size_t n, const double x, const double y, double * out)
+{
+    selected().squared_distances(xs, ys, n, x, y, out);
+}
+
+const char * kdtree::kernels::implementation()
+{
+    return selected().name;
+}
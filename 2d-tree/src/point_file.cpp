@@ -0,0 +1,172 @@
+#include "primitives.h"
+
+#include "thread_pool.h"
+
+#include <charconv>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+// bytes parsed by one task, the actual chunks are longer up to the next line end
+constexpr std::size_t chunk_bytes = 1 << 20;
+
+bool is_space(const char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+// appends the coordinates of the line [first, last), leaves coords as they were if it's malformed
+bool parse_line(const char * first, const char * last, const std::size_t dimension, std::vector<double> & coords)
+{
+    const std::size_t size = coords.size();
+    while (true) {
+        while (first < last && is_space(*first)) {
+            ++first;
+        }
+        if (first == last) {
+            break;
+        }
+        // from_chars doesn't take the explicit plus sign that operator>> does
+        if (*first == '+' && last - first > 1 && first[1] != '-') {
+            ++first;
+        }
+        double coord;
+        const auto [end, error] = std::from_chars(first, last, coord);
+        if (error != std::errc() || (end < last && !is_space(*end))) {
+            coords.resize(size);
+            return false;
+        }
+        coords.push_back(coord);
+        first = end;
+    }
+    if ((coords.size() - size) % dimension != 0) {
+        coords.resize(size);
+        return false;
+    }
+    return true;
+}
+
+struct Chunk
+{
+    std::size_t first;
+    std::size_t last;
+    std::vector<double> coords;
+    std::vector<std::size_t> malformed;
+};
+
+void parse(const char * base, const std::size_t dimension, Chunk & chunk)
+{
+    const char * first = base + chunk.first;
+    const char * const last = base + chunk.last;
+    while (first < last) {
+        const char * end = static_cast<const char *>(std::memchr(first, '\n', static_cast<std::size_t>(last - first)));
+        if (end == nullptr) {
+            end = last;
+        }
+        if (!parse_line(first, end, dimension, chunk.coords)) {
+            chunk.malformed.push_back(static_cast<std::size_t>(first - base));
+        }
+        first = end + 1;
+    }
+}
+
+// chunks of about chunk_bytes, each one starts at a line start
+std::vector<Chunk> split(const char * base, const std::size_t size)
+{
+    std::vector<Chunk> chunks;
+    std::size_t first = 0;
+    while (first < size) {
+        std::size_t last = size;
+        if (size - first > chunk_bytes) {
+            const auto * end = static_cast<const char *>(std::memchr(base + first + chunk_bytes, '\n', size - first - chunk_bytes));
+            if (end != nullptr) {
+                last = static_cast<std::size_t>(end - base) + 1;
+            }
+        }
+        chunks.push_back(Chunk{first, last, {}, {}});
+        first = last;
+    }
+    return chunks;
+}
+
+} // anonymous namespace
+
+CoordinateFile read_coordinate_file(const std::string & filename, const std::size_t dimension)
+{
+    const int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Can't read " + filename);
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        throw std::runtime_error("Can't read " + filename);
+    }
+    const auto size = static_cast<std::size_t>(st.st_size);
+    if (size == 0) {
+        ::close(fd);
+        return {};
+    }
+    void * address = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (address == MAP_FAILED) {
+        throw std::runtime_error("Can't map " + filename);
+    }
+    const std::unique_ptr<void, std::function<void(void *)>> mapping(address, [size](void * p) {
+        ::munmap(p, size);
+    });
+    const char * base = static_cast<const char *>(address);
+    ::madvise(address, size, MADV_SEQUENTIAL);
+
+    auto chunks = split(base, size);
+    ThreadPool::instance().parallel_for(chunks.size(), 1, [&](const std::size_t first, const std::size_t last) {
+        for (std::size_t i = first; i < last; ++i) {
+            parse(base, dimension, chunks[i]);
+        }
+    });
+
+    CoordinateFile result;
+    std::size_t coords = 0;
+    for (const auto & chunk : chunks) {
+        coords += chunk.coords.size();
+    }
+    result.coords.reserve(coords);
+    for (auto & chunk : chunks) {
+        result.coords.insert(result.coords.end(), chunk.coords.begin(), chunk.coords.end());
+        result.malformed.insert(result.malformed.end(), chunk.malformed.begin(), chunk.malformed.end());
+        chunk.coords = {};
+    }
+    return result;
+}
+
+std::vector<double> read_coordinates(const std::string & filename, const std::size_t dimension)
+{
+    static constexpr std::size_t reported = 10;
+
+    auto file = read_coordinate_file(filename, dimension);
+    for (std::size_t i = 0; i < std::min(file.malformed.size(), reported); ++i) {
+        std::cerr << "Malformed line at byte " << file.malformed[i] << " of " << filename << ".\n";
+    }
+    if (file.malformed.size() > reported) {
+        std::cerr << file.malformed.size() - reported << " more malformed lines in " << filename << ".\n";
+    }
+    return std::move(file.coords);
+}
+
+PointFile read_point_file(const std::string & filename)
+{
+    auto file = read_coordinate_file(filename, 2);
+    PointFile result;
+    result.points.reserve(file.coords.size() / 2);
+    for (std::size_t i = 0; i < file.coords.size(); i += 2) {
+        result.points.emplace_back(file.coords[i], file.coords[i + 1]);
+    }
+    result.malformed = std::move(file.malformed);
+    return result;
+}
@@ -0,0 +1,157 @@
+#include "primitives.h"
+
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Snapshot file:
+//   FileHeader
+//   TreeHeader for every tree of the forest
+//   memory blocks of the trees, each one aligned to a cache line and laid out by StaticTree<2>::Layout
+// Everything is stored in the native byte order, byte_order tells if a file came from another one.
+
+namespace {
+
+const char magic[8] = {'K', 'D', 'T', 'R', 'E', 'E', '2', 'D'};
+const std::uint32_t version = 2;
+const std::uint32_t byte_order = 0x01020304;
+const std::size_t alignment = 64;
+
+struct FileHeader
+{
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t byte_order;
+    std::uint64_t trees;
+    std::uint64_t points;
+    std::uint64_t leaf_size;
+};
+
+struct TreeHeader
+{
+    std::uint64_t offset;
+    std::uint64_t slots;
+    double xmin;
+    double ymin;
+    double xmax;
+    double ymax;
+};
+
+std::size_t align(const std::size_t offset)
+{
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+std::runtime_error snapshot_error(const std::string & path, const std::string & what)
+{
+    return std::runtime_error("Bad snapshot " + path + ": " + what);
+}
+
+} // anonymous namespace
+
+void kdtree::PointSet::save(const std::string & path) const
+{
+    std::ofstream fs(path, std::ios::binary | std::ios::trunc);
+    if (!fs) {
+        throw std::runtime_error("Can't write " + path);
+    }
+
+    FileHeader header{};
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.version = version;
+    header.byte_order = byte_order;
+    const auto & forest = set.trees();
+    header.trees = forest.size();
+    header.points = set.size();
+    header.leaf_size = Tree::leaf_size;
+    fs.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+    std::size_t offset = align(sizeof(FileHeader) + forest.size() * sizeof(TreeHeader));
+    for (const auto & tree : forest) {
+        const auto & region = tree->region();
+        const TreeHeader tree_header{offset, tree->slot_count(), region.min[0], region.min[1], region.max[0], region.max[1]};
+        fs.write(reinterpret_cast<const char *>(&tree_header), sizeof(tree_header));
+        offset = align(offset + Tree::Layout(tree->slot_count()).bytes);
+    }
+
+    const char padding[alignment] = {};
+    for (const auto & tree : forest) {
+        const auto position = static_cast<std::size_t>(fs.tellp());
+        fs.write(padding, static_cast<std::streamsize>(align(position) - position));
+        fs.write(tree->data(), static_cast<std::streamsize>(Tree::Layout(tree->slot_count()).bytes));
+    }
+    if (!fs.flush()) {
+        throw std::runtime_error("Can't write " + path);
+    }
+}
+
+kdtree::PointSet kdtree::PointSet::load(const std::string & path)
+{
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Can't read " + path);
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        throw std::runtime_error("Can't read " + path);
+    }
+    const auto size = static_cast<std::size_t>(st.st_size);
+    if (size < sizeof(FileHeader)) {
+        ::close(fd);
+        throw snapshot_error(path, "truncated header");
+    }
+    // private and writable, so erase on a loaded set only copies the pages it touches
+    void * address = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (address == MAP_FAILED) {
+        throw std::runtime_error("Can't map " + path);
+    }
+    const std::shared_ptr<void> mapping(address, [size](void * p) {
+        ::munmap(p, size);
+    });
+    char * base = static_cast<char *>(address);
+
+    FileHeader header;
+    std::memcpy(&header, base, sizeof(header));
+    if (std::memcmp(header.magic, magic, sizeof(magic)) != 0) {
+        throw snapshot_error(path, "not a kd-tree snapshot");
+    }
+    if (header.byte_order != byte_order) {
+        throw snapshot_error(path, "written with another byte order");
+    }
+    if (header.version != version) {
+        throw snapshot_error(path, "unsupported version " + std::to_string(header.version));
+    }
+    if (header.leaf_size != Tree::leaf_size) {
+        throw snapshot_error(path, "built with leaf size " + std::to_string(header.leaf_size));
+    }
+    if (header.trees > (size - sizeof(FileHeader)) / sizeof(TreeHeader)) {
+        throw snapshot_error(path, "truncated tree table");
+    }
+
+    std::vector<std::shared_ptr<Tree>> forest;
+    for (std::size_t i = 0; i < header.trees; ++i) {
+        TreeHeader tree_header;
+        std::memcpy(&tree_header, base + sizeof(FileHeader) + i * sizeof(TreeHeader), sizeof(tree_header));
+        if (tree_header.slots == 0 || tree_header.slots > std::numeric_limits<std::uint32_t>::max()) {
+            throw snapshot_error(path, "bad size of tree " + std::to_string(i));
+        }
+        const std::size_t bytes = Tree::Layout(tree_header.slots).bytes;
+        if (tree_header.offset % alignment != 0 || tree_header.offset > size || bytes > size - tree_header.offset) {
+            throw snapshot_error(path, "tree " + std::to_string(i) + " is out of the file");
+        }
+        const Tree::Box region{{tree_header.xmin, tree_header.ymin}, {tree_header.xmax, tree_header.ymax}};
+        forest.push_back(std::make_shared<Tree>(region, tree_header.slots, mapping, base + tree_header.offset));
+    }
+    PointSet set(Forest(std::move(forest)));
+    if (set.size() != header.points) {
+        throw snapshot_error(path, "point count doesn't match the trees");
+    }
+    return set;
+}
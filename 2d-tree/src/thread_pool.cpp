@@ -0,0 +1,148 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+
+namespace {
+
+thread_local const ThreadPool * current_pool = nullptr;
+thread_local std::size_t current_index = 0;
+
+} // anonymous namespace
+
+ThreadPool::ThreadPool(const std::size_t threads)
+{
+    queues.reserve(threads + 1);
+    for (std::size_t i = 0; i <= threads; ++i) {
+        queues.push_back(std::make_unique<Queue>());
+    }
+    workers.reserve(threads);
+    for (std::size_t i = 0; i < threads; ++i) {
+        workers.emplace_back([this, i] { work(i); });
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    stop = true;
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+    }
+    wake.notify_all();
+    for (auto & worker : workers) {
+        worker.join();
+    }
+}
+
+ThreadPool & ThreadPool::instance()
+{
+    // the calling thread works too while it waits for a join
+    static ThreadPool pool(std::max(1U, std::thread::hardware_concurrency()) - 1);
+    return pool;
+}
+
+void ThreadPool::Task::run()
+{
+    try {
+        function();
+    }
+    catch (...) {
+        error = std::current_exception();
+    }
+    done.store(true, std::memory_order_release);
+}
+
+std::size_t ThreadPool::current_queue() const
+{
+    if (current_pool == this) {
+        return current_index;
+    }
+    return queues.size() - 1;
+}
+
+void ThreadPool::push(Task & task)
+{
+    Queue & queue = *queues[current_queue()];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(&task);
+    }
+    ++pending;
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+    }
+    wake.notify_one();
+}
+
+void ThreadPool::join(Task & task)
+{
+    const std::size_t queue = current_queue();
+    if (pop_own(task, queue)) {
+        task.run();
+        return;
+    }
+    // the task was stolen, help others until the thief is done with it
+    while (!task.done.load(std::memory_order_acquire)) {
+        if (Task * other = steal(queue)) {
+            other->run();
+        }
+        else {
+            std::this_thread::yield();
+        }
+    }
+}
+
+bool ThreadPool::pop_own(const Task & task, const std::size_t queue)
+{
+    Queue & own = *queues[queue];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    // the outside queue is shared, so the task isn't necessarily the last one there
+    const auto it = std::find(own.tasks.rbegin(), own.tasks.rend(), &task);
+    if (it == own.tasks.rend()) {
+        return false;
+    }
+    own.tasks.erase(std::next(it).base());
+    --pending;
+    return true;
+}
+
+ThreadPool::Task * ThreadPool::steal(const std::size_t thief)
+{
+    for (std::size_t i = 1; i < queues.size(); ++i) {
+        Queue & victim = *queues[(thief + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            Task * task = victim.tasks.front();
+            victim.tasks.pop_front();
+            --pending;
+            return task;
+        }
+    }
+    return nullptr;
+}
+
+void ThreadPool::work(const std::size_t index)
+{
+    current_pool = this;
+    current_index = index;
+    Queue & own = *queues[index];
+    while (!stop) {
+        Task * task = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.tasks.empty()) {
+                task = own.tasks.back();
+                own.tasks.pop_back();
+                --pending;
+            }
+        }
+        if (task == nullptr) {
+            task = steal(index);
+        }
+        if (task != nullptr) {
+            task->run();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleep_mutex);
+        wake.wait(lock, [this] { return stop || pending > 0; });
+    }
+}
@@ -0,0 +1,97 @@
+#include "calc.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <vector>
+
+// Сравнение пакетного execute со скалярным execute после set_precision(Precision::FAST):
+// каждая программа применяется к одному и тому же набору регистров, значения и режим должны
+// совпадать до бита (NaN - с NaN). Набор фиксирован: особые значения, кратные 15°, и случайные
+// числа из нескольких областей от постоянного зерна, всего больше трёх блоков пакетного выполнения.
+// Выход с кодом 1 при первом расхождении.
+// Usage: batch_check
+
+namespace {
+
+std::vector<double> inputs()
+{
+    const double inf = std::numeric_limits<double>::infinity();
+    std::vector<double> x{0, -0.0, 0.5, -0.5, 1, -1, 2, 1e-300, -1e-310, 1e5, 1e15, 1e16, 1e300, -1e300, inf, -inf, std::numeric_limits<double>::quiet_NaN()};
+    for (int degrees = -1080; degrees <= 1080; degrees += 15) {
+        x.push_back(degrees);
+    }
+    std::mt19937_64 random(20240601);
+    std::uniform_real_distribution<double> unit(-1.2, 1.2);
+    std::uniform_real_distribution<double> circle(-720, 720);
+    std::uniform_real_distribution<double> exponent(-20, 40);
+    while (x.size() < 3500) {
+        x.push_back(unit(random));
+        x.push_back(circle(random));
+        x.push_back(std::exp(exponent(random)) * (random() % 2 == 0 ? 1 : -1));
+    }
+    return x;
+}
+
+bool same(const double a, const double b)
+{
+    return std::memcmp(&a, &b, sizeof(double)) == 0 || (std::isnan(a) && std::isnan(b));
+}
+
+bool check(const Program & program, const bool rad_on, const std::vector<double> & x)
+{
+    std::vector<double> batch = x;
+    std::vector<std::uint8_t> errors(x.size());
+    bool batch_rad_on = rad_on;
+    execute(program, batch.data(), batch.size(), batch_rad_on, errors.data());
+    for (std::size_t i = 0; i < x.size(); ++i) {
+        bool scalar_rad_on = rad_on;
+        const double scalar = execute(program, x[i], scalar_rad_on);
+        if (!same(batch[i], scalar) || batch_rad_on != scalar_rad_on) {
+            std::cout << std::setprecision(std::numeric_limits<double>::max_digits10) << "op " << static_cast<int>(program.front().op) << " of "
+                      << program.size() << ", " << (rad_on ? "RAD" : "DEG") << ", x = " << x[i] << ": batch " << batch[i] << ", scalar " << scalar << "\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+} // anonymous namespace
+
+int main()
+{
+    set_precision(Precision::FAST);
+    // скалярный execute сообщает об ошибках в std::cerr
+    std::ostringstream ignored;
+    auto * const cerr = std::cerr.rdbuf(ignored.rdbuf());
+
+    std::vector<Program> programs;
+    for (const Op op : {Op::SQRT, Op::NEG, Op::SIN, Op::COS, Op::TAN, Op::CTN, Op::ASIN, Op::ACOS, Op::ATAN, Op::ACTN}) {
+        programs.push_back({{op, 0}});
+    }
+    for (const Op op : {Op::SET, Op::ADD, Op::SUB, Op::MUL, Op::DIV, Op::REM, Op::POW}) {
+        for (const double arg : {0.0, 0.5, 3.0, 1e9}) {
+            programs.push_back({{op, arg}});
+        }
+    }
+    programs.push_back({{Op::SIN, 0}, {Op::RAD, 0}, {Op::ACOS, 0}, {Op::DEG, 0}, {Op::TAN, 0}, {Op::MUL, 90}, {Op::CTN, 0}, {Op::ATAN, 0}});
+    programs.push_back({{Op::DIV, 7}, {Op::SQRT, 0}, {Op::ASIN, 0}, {Op::RAD, 0}, {Op::COS, 0}, {Op::ACTN, 0}});
+
+    const auto x = inputs();
+    bool ok = true;
+    for (const auto & program : programs) {
+        for (const bool rad_on : {true, false}) {
+            ok = ok && check(program, rad_on, x);
+        }
+    }
+    std::cerr.rdbuf(cerr);
+    std::cout << (ok ? "batch execute agrees with scalar execute" : "batch execute differs") << " on " << programs.size() << " programs, "
+              << x.size() << " registers\n";
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,84 @@
+#include "calc.h"
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <string_view>
+
+// Время разбора одной строки parse_line для каждой операции Op, в JSON на stdout.
+// Каждая строка разбирается iterations раз подряд.
+// Usage: parse_ops [--iterations n]
+
+namespace {
+
+struct Sample
+{
+    const char * op;
+    std::string_view line;
+};
+
+const Sample samples[]{
+        {"ERR", "FOO"},
+        {"SET", "42"},
+        {"ADD", "+ 1.5"},
+        {"SUB", "- 1.5"},
+        {"MUL", "* 2"},
+        {"DIV", "/ 3"},
+        {"REM", "% 3"},
+        {"NEG", "_"},
+        {"POW", "^ 2"},
+        {"SQRT", "SQRT"},
+        {"SIN", "SIN"},
+        {"COS", "COS"},
+        {"TAN", "TAN"},
+        {"CTN", "CTN"},
+        {"ASIN", "ASIN"},
+        {"ACOS", "ACOS"},
+        {"ATAN", "ATAN"},
+        {"ACTN", "ACTN"},
+        {"RAD", "RAD"},
+        {"DEG", "DEG"}};
+
+double ns_per_parse(const std::string_view line, const std::size_t iterations, std::uint64_t & checksum)
+{
+    const auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < iterations; ++i) {
+        Instruction instruction{Op::ERR, 0};
+        std::size_t position = 0;
+        const Error error = parse_line(line, instruction, position);
+        checksum += static_cast<std::uint64_t>(instruction.op) + static_cast<std::uint64_t>(error) + position;
+    }
+    const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / static_cast<double>(iterations);
+}
+
+} // anonymous namespace
+
+int main(int argc, char ** argv)
+{
+    std::size_t iterations = 1000000;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (std::string(argv[i]) == "--iterations") {
+            iterations = static_cast<std::size_t>(std::stod(argv[i + 1]));
+        }
+        else {
+            std::cerr << "Unknown option " << argv[i] << std::endl;
+            return 1;
+        }
+    }
+    if (iterations == 0) {
+        iterations = 1;
+    }
+
+    std::uint64_t checksum = 0;
+    std::cout << "{\n  \"iterations\": " << iterations << ",\n  \"results\": [";
+    bool first = true;
+    for (const auto & sample : samples) {
+        const double ns = ns_per_parse(sample.line, iterations, checksum);
+        std::cout << (first ? "" : ",") << "\n    {\"op\": \"" << sample.op << "\", \"line\": \"" << sample.line
+                  << "\", \"ns_per_parse\": " << ns << "}";
+        first = false;
+    }
+    std::cout << "\n  ],\n  \"checksum\": " << checksum << "\n}" << std::endl;
+}
@@ -0,0 +1,165 @@
+#include "calc.h"
+
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Сравнение replay с построчным циклом process_line (см. оценку в calc.h).
+// 1. Случайные логы из SET, + и - с положительными аргументами, * и / на числа из [0.1, 10] и SQRT.
+//    Значения в них положительны, сокращения нет, и разница не усиливается: каждая свёрнутая серия
+//    добавляет не больше 5(m + 1) ulp, а каждая операция, выполненная от другого начального значения
+//    куска, - не больше ulp.
+// 2. Логи, в которых сокращение даёт точный ноль и следующие * его увеличивают. Свёртка раньше
+//    оставляла в них малое число вместо нуля.
+// В обоих случаях строка после M операций от последнего SET не может отличаться от последовательного
+// прогона больше чем на 12(M + 1) ulp, в частности ноль должен остаться нулём.
+// Каждый лог прогоняется в 1, 2, 3 и 8 потоках. Выход с кодом 1 при первом расхождении.
+// Usage: replay_check [logs] [lines] [seed]
+
+namespace {
+
+const std::size_t thread_counts[] = {1, 2, 3, 8};
+
+// значения после каждой строки лога
+std::vector<double> sequential(const std::string & text)
+{
+    std::vector<double> values;
+    double current = 0;
+    bool rad_on = false;
+    std::istringstream lines(text);
+    for (std::string line; std::getline(lines, line);) {
+        current = process_line(current, rad_on, std::string_view(line)).value;
+        values.push_back(current);
+    }
+    return values;
+}
+
+std::vector<double> parallel(const std::string & text, const std::size_t threads)
+{
+    std::ostringstream out;
+    std::ostringstream log;
+    out << std::setprecision(std::numeric_limits<double>::max_digits10);
+    bool rad_on = false;
+    replay(text, 0, rad_on, out, log, threads);
+    std::vector<double> values;
+    std::istringstream lines(out.str());
+    for (std::string line; std::getline(lines, line);) {
+        values.push_back(std::strtod(line.c_str(), nullptr));
+    }
+    return values;
+}
+
+double ulps(const double x, const double y)
+{
+    if (x == y || (std::isnan(x) && std::isnan(y))) {
+        return 0;
+    }
+    const double ulp = std::nextafter(std::fabs(y), std::numeric_limits<double>::infinity()) - std::fabs(y);
+    return std::fabs(x - y) / ulp;
+}
+
+bool check(const std::string & name, const std::string & text)
+{
+    const auto expected = sequential(text);
+    // допустимая разница после каждой строки в ulp
+    std::vector<double> tolerance;
+    std::size_t since_set = 0;
+    std::istringstream lines(text);
+    for (std::string line; std::getline(lines, line);) {
+        since_set = std::isdigit(static_cast<unsigned char>(line[0])) ? 0 : since_set + 1;
+        tolerance.push_back(12 * static_cast<double>(since_set + 1));
+    }
+    for (const std::size_t threads : thread_counts) {
+        const auto values = parallel(text, threads);
+        if (values.size() != expected.size()) {
+            std::cerr << name << ", " << threads << " threads: " << values.size() << " values instead of " << expected.size() << "\n";
+            return false;
+        }
+        for (std::size_t i = 0; i < values.size(); ++i) {
+            if (!(ulps(values[i], expected[i]) <= tolerance[i])) {
+                std::cerr << std::setprecision(std::numeric_limits<double>::max_digits10) << name << ", " << threads << " threads, line " << i + 1
+                          << ": " << values[i] << " instead of " << expected[i] << ", " << ulps(values[i], expected[i]) << " ulp\n";
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool check_positive(const std::size_t logs, const std::size_t lines, std::mt19937_64 & random)
+{
+    std::uniform_int_distribution<int> kind(0, 15);
+    std::uniform_real_distribution<double> addend(0, 1000);
+    std::uniform_real_distribution<double> factor(0.1, 10);
+    for (std::size_t n = 0; n < logs; ++n) {
+        std::ostringstream text;
+        text << std::fixed << std::setprecision(4);
+        for (std::size_t i = 0; i < lines; ++i) {
+            const int k = i == 0 ? 0 : kind(random);
+            if (k == 0) {
+                text << addend(random) + 1 << "\n";
+            }
+            else if (k < 6) {
+                text << "+ " << addend(random) << "\n";
+            }
+            else if (k < 10) {
+                text << "* " << factor(random) << "\n";
+            }
+            else if (k < 14) {
+                text << "/ " << factor(random) << "\n";
+            }
+            else {
+                text << "SQRT\n";
+            }
+        }
+        if (!check("positive log " + std::to_string(n), text.str())) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string repeat(const std::string & line, const std::size_t count)
+{
+    std::string result;
+    for (std::size_t i = 0; i < count; ++i) {
+        result += line;
+    }
+    return result;
+}
+
+bool check_cancellation()
+{
+    const std::string logs[] = {
+            "1\n" + repeat("* 1\n", 50) + repeat("/ 1000000000\n", 2) + "+ 1\n- 1\n" + repeat("* 1\n", 50) + repeat("* 1000000000\n", 2),
+            "3\n" + repeat("/ 7\n", 40) + "+ 3\n- 3\n" + repeat("* 7\n", 40) + "SQRT\n" + repeat("- 2\n+ 2\n", 30),
+            "0\n" + repeat("+ 0.1\n- 0.1\n* 3\n", 30) + repeat("* 1000000000\n", 30)};
+    for (std::size_t n = 0; n < std::size(logs); ++n) {
+        if (!check("cancellation log " + std::to_string(n), logs[n])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // anonymous namespace
+
+int main(int argc, char ** argv)
+{
+    const std::size_t logs = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 200;
+    const std::size_t lines = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 2000;
+    std::mt19937_64 random(argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 42);
+
+    const bool ok = check_cancellation() && check_positive(logs, lines, random);
+    std::cout << (ok ? "replay agrees with process_line" : "replay differs") << " on " << logs << " logs of " << lines << " lines\n";
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,242 @@
+#include "trig.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+// Точность и скорость ядер trig.h в режимах FAST и PRECISE и прежних формул через libm
+// (аргумент в градусах умножается на пи / 180, результат аркфункций - на 180 / пи,
+// ACTN = пи / 2 - atan) на нескольких областях аргументов, в JSON на stdout.
+// Ошибка считается в ulp относительно значения в long double, где градусы сводятся точно.
+// Usage: trig_kernels [--points n] [--seed s]
+
+namespace {
+
+using Kernel = std::function<double(double)>;
+using Reference = std::function<long double(double)>;
+
+const long double pi = 3.141592653589793238462643383279502884L;
+const double eps = 1e-15;
+
+struct Domain
+{
+    std::string name;
+    std::vector<double> points;
+};
+
+struct Function
+{
+    std::string name;
+    bool rad_on;
+    Reference reference;
+    std::vector<std::pair<std::string, Kernel>> variants;
+    std::vector<Domain> domains;
+};
+
+// синус (shift = 0) или косинус (shift = 1) x градусов
+long double sin_cos_degrees(const double x, const int shift)
+{
+    const long double y = std::fmod(static_cast<long double>(x), 360.0L);
+    const long double q = std::nearbyint(y / 90);
+    const long double r = (y - 90 * q) * pi / 180;
+    switch ((static_cast<int>(q) + shift + 8) % 4) {
+    case 0: return std::sin(r);
+    case 1: return std::cos(r);
+    case 2: return -std::sin(r);
+    default: return -std::cos(r);
+    }
+}
+
+long double tan_degrees(const double x)
+{
+    return sin_cos_degrees(x, 0) / sin_cos_degrees(x, 1);
+}
+
+long double degrees(const long double x)
+{
+    return 180 * x / pi;
+}
+
+double ulp(const long double reference)
+{
+    const double r = static_cast<double>(std::fabs(reference));
+    return r == 0 ? std::numeric_limits<double>::denorm_min() : std::ldexp(1.0, std::max(std::ilogb(r), -1022) - 52);
+}
+
+// ошибка в ulp, бесконечность - если значения несравнимы
+double error(const double value, const long double reference)
+{
+    if (std::isnan(reference)) {
+        return std::isnan(value) ? 0 : INFINITY;
+    }
+    if (static_cast<long double>(value) == reference) {
+        return 0;
+    }
+    if (std::isinf(reference) || std::isinf(value) || std::isnan(value)) {
+        return INFINITY;
+    }
+    return static_cast<double>(std::fabs(value - reference) / ulp(reference));
+}
+
+std::vector<double> uniform(std::mt19937_64 & random, const std::size_t n, const double from, const double to)
+{
+    std::uniform_real_distribution<double> distribution(from, to);
+    std::vector<double> points(n);
+    for (auto & x : points) {
+        x = distribution(random);
+    }
+    return points;
+}
+
+// |x| распределён равномерно по порядкам в [from, to], знак случайный
+std::vector<double> log_uniform(std::mt19937_64 & random, const std::size_t n, const double from, const double to)
+{
+    std::uniform_real_distribution<double> distribution(std::log(from), std::log(to));
+    std::vector<double> points(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        points[i] = std::exp(distribution(random)) * (i % 2 == 0 ? 1 : -1);
+    }
+    return points;
+}
+
+std::vector<double> integers(const int from, const int to)
+{
+    std::vector<double> points;
+    for (int i = from; i <= to; ++i) {
+        points.push_back(i);
+    }
+    return points;
+}
+
+// 1 - d и -1 + d для d от 1e-16 до 0.1
+std::vector<double> near_one(std::mt19937_64 & random, const std::size_t n)
+{
+    auto points = log_uniform(random, n, 1e-16, 0.1);
+    for (auto & x : points) {
+        x = x > 0 ? 1 - x : -1 - x;
+    }
+    return points;
+}
+
+double ctn(const double t)
+{
+    return std::fabs(t) < eps ? (t < 0 ? -INFINITY : INFINITY) : 1 / t;
+}
+
+std::vector<std::pair<std::string, Kernel>> forward(double (*kernel)(double, bool, Precision), const bool rad_on, const Kernel & libm)
+{
+    return {
+            {"libm", libm},
+            {"precise", [kernel, rad_on](const double x) { return kernel(x, rad_on, Precision::PRECISE); }},
+            {"fast", [kernel, rad_on](const double x) { return kernel(x, rad_on, Precision::FAST); }}};
+}
+
+std::vector<Function> functions(const std::size_t n, const std::uint64_t seed)
+{
+    std::mt19937_64 random(seed);
+    const std::vector<Domain> radians{
+            {"[-2pi, 2pi]", uniform(random, n, -2 * M_PI, 2 * M_PI)},
+            {"1e-10..1e5", log_uniform(random, n, 1e-10, 1e5)},
+            {"1e5..1e15", log_uniform(random, n, 1e5, 1e15)}};
+    const std::vector<Domain> degrees_domains{
+            {"[-720, 720]", uniform(random, n, -720, 720)},
+            {"integers [-1080, 1080]", integers(-1080, 1080)},
+            {"1e-10..1e15", log_uniform(random, n, 1e-10, 1e15)}};
+    const std::vector<Domain> unit{
+            {"[-1, 1]", uniform(random, n, -1, 1)},
+            {"near ±1", near_one(random, n)},
+            {"±0.5, ±1, 0", {-1, -0.5, 0, 0.5, 1}}};
+    const std::vector<Domain> line{
+            {"1e-10..1e10", log_uniform(random, n, 1e-10, 1e10)},
+            {"±1, 0", {-1, 0, 1}}};
+    const auto to_radians = [](const double x) { return M_PI * x / 180; };
+    const auto to_degrees = [](const double x) { return 180 * x / M_PI; };
+
+    std::vector<Function> result;
+    for (const bool rad_on : {true, false}) {
+        const auto & trig_domains = rad_on ? radians : degrees_domains;
+        const auto arg = [rad_on, to_radians](const double x) { return rad_on ? x : to_radians(x); };
+        const auto value = [rad_on, to_degrees](const double x) { return rad_on ? x : to_degrees(x); };
+        const auto arc = [rad_on](const long double x) { return rad_on ? x : degrees(x); };
+        result.push_back({"SIN", rad_on, [rad_on](const double x) { return rad_on ? std::sin(static_cast<long double>(x)) : sin_cos_degrees(x, 0); }, forward(trig::sin, rad_on, [arg](const double x) { return std::sin(arg(x)); }), trig_domains});
+        result.push_back({"COS", rad_on, [rad_on](const double x) { return rad_on ? std::cos(static_cast<long double>(x)) : sin_cos_degrees(x, 1); }, forward(trig::cos, rad_on, [arg](const double x) { return std::cos(arg(x)); }), trig_domains});
+        result.push_back({"TAN", rad_on, [rad_on](const double x) { return rad_on ? std::tan(static_cast<long double>(x)) : tan_degrees(x); }, forward(trig::tan, rad_on, [arg](const double x) { return std::tan(arg(x)); }), trig_domains});
+        // котангенс сравнивается только там, где тангенс не заменяется бесконечностью
+        const auto ctn_reference = [rad_on](const double x) -> long double {
+            const long double t = rad_on ? std::tan(static_cast<long double>(x)) : tan_degrees(x);
+            return std::fabs(t) < 2 * eps ? NAN : 1 / t;
+        };
+        result.push_back({"CTN", rad_on, ctn_reference, {{"libm", [arg](const double x) { return ctn(std::tan(arg(x))); }}, {"precise", [rad_on](const double x) { return ctn(trig::tan(x, rad_on, Precision::PRECISE)); }}, {"fast", [rad_on](const double x) { return ctn(trig::tan(x, rad_on, Precision::FAST)); }}}, trig_domains});
+        result.push_back({"ASIN", rad_on, [arc](const double x) { return arc(std::asin(static_cast<long double>(x))); }, forward(trig::asin, rad_on, [value](const double x) { return value(std::asin(x)); }), unit});
+        result.push_back({"ACOS", rad_on, [arc](const double x) { return arc(std::acos(static_cast<long double>(x))); }, forward(trig::acos, rad_on, [value](const double x) { return value(std::acos(x)); }), unit});
+        result.push_back({"ATAN", rad_on, [arc](const double x) { return arc(std::atan(static_cast<long double>(x))); }, forward(trig::atan, rad_on, [value](const double x) { return value(std::atan(x)); }), line});
+        result.push_back({"ACTN", rad_on, [arc](const double x) { return arc(std::atan2(1.0L, static_cast<long double>(x))); }, forward(trig::actn, rad_on, [value](const double x) { return value(M_PI_2 - std::atan(x)); }), line});
+    }
+    return result;
+}
+
+} // anonymous namespace
+
+int main(int argc, char ** argv)
+{
+    std::size_t n = 200000;
+    std::uint64_t seed = 42;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const std::string name = argv[i];
+        if (name == "--points") {
+            n = static_cast<std::size_t>(std::stod(argv[i + 1]));
+        }
+        else if (name == "--seed") {
+            seed = std::stoull(argv[i + 1]);
+        }
+        else {
+            std::cerr << "Unknown option " << name << std::endl;
+            return 1;
+        }
+    }
+
+    std::cout << "{\n  \"points\": " << n << ",\n  \"results\": [";
+    bool first = true;
+    for (const auto & function : functions(n, seed)) {
+        for (const auto & domain : function.domains) {
+            std::vector<long double> references;
+            for (const double x : domain.points) {
+                // аргументы, на которых значение не определено, в сравнение не попадают
+                references.push_back(function.reference(x));
+            }
+            for (const auto & [variant, kernel] : function.variants) {
+                double max_ulp = 0;
+                double sum_ulp = 0;
+                std::size_t compared = 0;
+                std::vector<double> values(domain.points.size());
+                const auto start = std::chrono::steady_clock::now();
+                std::transform(domain.points.begin(), domain.points.end(), values.begin(), kernel);
+                const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+                for (std::size_t i = 0; i < values.size(); ++i) {
+                    if (std::isnan(references[i])) {
+                        continue;
+                    }
+                    const double e = error(values[i], references[i]);
+                    max_ulp = std::max(max_ulp, e);
+                    sum_ulp += e;
+                    ++compared;
+                }
+                std::cout << (first ? "" : ",") << "\n    {\"function\": \"" << function.name << "\", \"unit\": \""
+                          << (function.rad_on ? "rad" : "deg") << "\", \"domain\": \"" << domain.name << "\", \"variant\": \""
+                          << variant << "\", \"compared\": " << compared << ", \"max_ulp\": "
+                          << (std::isinf(max_ulp) ? std::string("\"inf\"") : std::to_string(max_ulp)) << ", \"mean_ulp\": "
+                          << (std::isinf(sum_ulp) ? std::string("\"inf\"") : std::to_string(compared == 0 ? 0 : sum_ulp / static_cast<double>(compared)))
+                          << ", \"ns_per_call\": " << elapsed.count() / static_cast<double>(std::max<std::size_t>(values.size(), 1)) << "}";
+                first = false;
+            }
+        }
+    }
+    std::cout << "\n  ]\n}" << std::endl;
+}
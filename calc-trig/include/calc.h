@@ -1,5 +1,146 @@
 #pragma once
 
+#include "trig.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
 #include <string>
+#include <string_view>
+#include <vector>
+
+enum class Op
+{
+    ERR,
+    SET,
+    ADD,
+    SUB,
+    MUL,
+    DIV,
+    REM,
+    NEG,
+    POW,
+    SQRT,
+    SIN,
+    COS,
+    TAN,
+    CTN,
+    ASIN,
+    ACOS,
+    ATAN,
+    ACTN,
+    RAD,
+    DEG
+};
+
+// одна разобранная строка, arg используется только бинарными операциями
+struct Instruction
+{
+    Op op;
+    double arg;
+};
+
+using Program = std::vector<Instruction>;
+
+enum class Error
+{
+    NONE,
+    UNKNOWN_OPERATION,
+    // у бинарной операции нет аргумента или он начинается не с цифры
+    NO_ARGUMENT,
+    // недопустимый символ в аргументе
+    BAD_ARGUMENT,
+    // аргумент длиннее допустимого числа цифр
+    ARGUMENT_SUFFIX,
+    UNARY_SUFFIX,
+    BAD_DIVISOR,
+    BAD_REMAINDER,
+    BAD_SQRT
+};
+
+// значение регистра после строки (при ошибке - прежнее) и позиция в строке, на которой остановился разбор
+struct Result
+{
+    double value;
+    Error error;
+    std::size_t position;
+};
+
+// разбирает одну строку в инструкцию, при ошибке instruction не меняется
+Error parse_line(std::string_view line, Instruction & instruction, std::size_t & position);
+
+// выполняет одну инструкцию, при ошибке возвращает current и выставляет error
+double step(const Instruction & instruction, double current, bool & rad_on, Error & error);
+
+// step без учёта в stats.h: для служебных вычислений replay и optimize, которые не выполняют строки лога
+double dispatch(const Instruction & instruction, double current, bool & rad_on, Error & error);
+
+// точность тригонометрических операций process_line, execute и replay, по умолчанию PRECISE
+// (см. trig.h); выбирается до начала вычислений
+void set_precision(Precision precision);
+
+// как process_line, но не выделяет память и ничего не пишет
+Result process_line(double current, bool & rad_on, std::string_view line);
+
+// пишет в log сообщение об ошибке result строки line, как process_line
+void report(std::ostream & log, std::string_view line, const Result & result);
+
+// то же, что и функции выше, но о синтаксических ошибках и ошибках вычисления пишут в log
+bool parse_line(std::string_view line, Instruction & instruction, std::ostream & log);
+double step(const Instruction & instruction, double current, bool & rad_on, std::ostream & log);
+
+// разбирает скрипт из строк, разделённых '\n', один раз;
+// строки с ошибками сообщаются в std::cerr и в программу не попадают
+Program compile(const std::string & script);
+
+// применяет программу к регистру, как последовательность вызовов process_line по строкам скрипта
+double execute(const Program & program, double current, bool & rad_on);
+
+// Упрощает программу, не меняя значения регистра и режима после execute: сокращает пары _,
+// убирает * 1, / 1 и - 0, вычисляет заранее всё после последнего SET до первой тригонометрической
+// операции и отбрасывает то, что было перед ним, а из RAD и DEG оставляет только те, что меняют
+// режим перед тригонометрическими операциями и в конце программы. С reassociate подряд идущие
+// + и - сворачиваются в одно сложение, а *, / и _ - в одно умножение; это меняет округление.
+// Сообщения об ошибках удалённых и вычисленных заранее инструкций не выводятся.
+// Возвращает число удалённых инструкций.
+std::size_t optimize(Program & program, bool reassociate);
+
+// флаги ошибок одного регистра при пакетном выполнении, объединяются по ИЛИ
+enum LaneError : std::uint8_t
+{
+    LANE_OK = 0,
+    LANE_BAD_DIVISOR = 1,
+    LANE_BAD_REMAINDER = 2,
+    LANE_BAD_SQRT = 4
+};
+
+// Применяет программу к n регистрам сразу, каждая операция выполняется векторно над блоком регистров.
+// Вместо сообщений в std::cerr ошибки отмечаются в errors[i], регистр при этом не меняется, как и в execute.
+// Арифметика и SQRT дают тот же результат, что и execute. Тригонометрия всегда считается ядрами FAST
+// из trig.h и совпадает до бита с execute после set_precision(Precision::FAST), это проверяет bench/batch_check.
+// rad_on общий для всех регистров.
+void execute(const Program & program, double * registers, std::size_t n, bool & rad_on, std::uint8_t * errors);
 
 double process_line(double current, bool & rad_on, const std::string & line);
+double process_line(double current, bool & rad_on, const char * line);
+
+// Прогоняет лог операций так же, как цикл process_line по его строкам: пишет в out значение регистра
+// после каждой строки, в log - сообщения об ошибках в порядке строк, возвращает последнее значение.
+// Лог делится на куски, которые разбираются и выполняются в threads потоках. Подряд идущие
+// +, -, *, /, _ и числа - аффинные отображения, внутри куска они сворачиваются в одно, и начальные
+// значения кусков находятся проходом по свёрткам, в котором честно выполняются только остальные операции.
+// Свёртка округляет иначе, чем последовательное выполнение, поэтому начальные значения кусков, а от них
+// и значения строк, могут отличаться от последовательного прогона:
+// - серия из m операций сворачивается, только если в ней нет сокращения (сложения, результат которого
+//   намного меньше слагаемых), и тогда её значение отличается от последовательного выполнения той же
+//   серии от того же значения не больше чем на 5(m + 1) ulp;
+// - серия с сокращением (например, / 1000000000, + 1, - 1) выполняется по одной операции;
+// - после SET значения совпадают точно.
+// Следующие операции переносят разницу, как любую погрешность аргумента, в том числе усиливают её
+// сокращением. replay_check сравнивает replay с последовательным прогоном.
+// Переполнения, бесконечности, NaN и уход в субнормальные числа воспроизводятся как при
+// последовательном прогоне. Серия обрывается на операции, после которой её коэффициенты стали бы
+// бесконечными, нулевыми или субнормальными. Серия, в которой для текущего значения регистра
+// какое-нибудь промежуточное значение может выйти за пределы нормальных чисел, выполняется по
+// одной операции.
+double replay(const std::string & text, double current, bool & rad_on, std::ostream & out, std::ostream & log, std::size_t threads);
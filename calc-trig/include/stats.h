@@ -0,0 +1,65 @@
+#pragma once
+
+#include "calc.h"
+
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Профилирование операций: число выполнений каждой Op, гистограммы их задержек в тактах
+// по степеням двойки и число ошибок каждого вида. Собирается только с CALC_STATS
+// (cmake -DCALC_STATS=ON); без него now и record пустые и исчезают при компиляции.
+// Выполнения считает step, то есть process_line, execute и replay, но не пакетный execute.
+// Служебные вычисления replay и optimize идут через dispatch и не считаются, так что
+// replay в несколько потоков даёт те же счётчики, что и последовательный прогон.
+// Ошибки считает report, по одной на каждое выведенное сообщение.
+
+namespace stats {
+
+#ifdef CALC_STATS
+inline constexpr bool enabled = true;
+#else
+inline constexpr bool enabled = false;
+#endif
+
+void count_step(Op op, std::uint64_t cycles);
+void count_error(Error error);
+
+// такты TSC, на других архитектурах - наносекунды
+inline std::uint64_t now()
+{
+    if constexpr (enabled) {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+    }
+    else {
+        return 0;
+    }
+}
+
+// start - значение now() перед выполнением op
+inline void record(const Op op, const std::uint64_t start)
+{
+    if constexpr (enabled) {
+        count_step(op, now() - start);
+    }
+}
+
+inline void record(const Error error)
+{
+    if constexpr (enabled) {
+        count_error(error);
+    }
+}
+
+// сводка по операциям и ошибкам; без CALC_STATS - сообщение, что статистика не собирается
+void print(std::ostream & out);
+
+} // namespace stats
@@ -0,0 +1,264 @@
+#pragma once
+
+#include <cmath>
+
+// Ядра тригонометрических операций калькулятора.
+//
+// PRECISE в радианах - это libm. В градусах аргумент сначала точно, без ошибки округления,
+// сводится к r из [-45°, 45°] и номеру четверти, и только r переводится в радианы, поэтому
+// кратные 90° дают точные 0 и 1, а кратные 30° и 45° - правильно округлённые значения
+// (0.5, sqrt(3) / 2, sqrt(2) / 2, 1 / sqrt(3), sqrt(3), 1): синус и косинус остатка r = ±30°
+// и ±45° берутся из таблицы, а тангенс и котангенс при таких r - сразу, без деления синуса
+// на косинус и 1 / tan, которые ошибаются на 1 ulp. Аркфункции от 0, ±0.5 и ±1 в градусах
+// возвращают точные целые градусы. ACTN считается как atan(1 / x), без вычитания из пи / 2.
+//
+// FAST - полиномы fdlibm для синуса и косинуса и рациональная аппроксимация арктангенса Cephes,
+// без вызовов libm; аргументы больше 1e5 радиан сводятся через libm.
+//
+// Ошибки относительно точного значения в ulp, максимум по перебору bench/trig_kernels, округлённый вверх:
+//            радианы           градусы
+//            PRECISE  FAST     PRECISE  FAST
+//   SIN      1        2.5      2        2
+//   COS      1        2.5      2        2
+//   TAN      1        3.5      3        3.5
+//   CTN      1.5      4        3.5      4
+//   ASIN     1        2.5      2.5      4
+//   ACOS     1        2        2.5      3.5
+//   ATAN     1        1        2.5      3
+//   ACTN     1.5      1.5      3        3
+// У CTN - там, где |tan| не меньше 1e-15 и котангенс не заменяется бесконечностью. Прежние формулы
+// через пи / 180 ошибаются в градусах на сотни тысяч ulp около нулей, а пи / 2 - atan - на 1e10 ulp
+// при больших аргументах.
+
+enum class Precision
+{
+    FAST,
+    PRECISE
+};
+
+namespace trig {
+
+double sin(double x, bool rad_on, Precision precision);
+double cos(double x, bool rad_on, Precision precision);
+double tan(double x, bool rad_on, Precision precision);
+// 1 / tan, при |tan| < tan_eps - бесконечность со знаком тангенса
+double ctn(double x, bool rad_on, Precision precision);
+double asin(double x, bool rad_on, Precision precision);
+double acos(double x, bool rad_on, Precision precision);
+double atan(double x, bool rad_on, Precision precision);
+double actn(double x, bool rad_on, Precision precision);
+
+// Дальше - части ядер FAST без ветвлений и вызовов функций, из которых собираются и скалярные
+// функции выше, и векторные циклы batch.cpp, так что оба пути считают одинаково.
+// Они в безымянном пространстве имён: batch.cpp собирается со своими флагами и target_clones,
+// и у каждой единицы трансляции должны быть свои копии, а не одна, выбранная компоновщиком.
+// Совпадение путей проверяет bench/batch_check.
+namespace {
+
+// round_to_integer(x) для |x| < 2^51 - ближайшее целое
+inline constexpr double round_magic = 6755399441055744.0; // 1.5 * 2^52
+
+// пи / 2 по частям (fdlibm): первые две по 33 бита, так что q * pio2_1 и q * pio2_2 точны при |q| < 2^20
+inline constexpr double two_over_pi = 6.36619772367581382433e-01;
+inline constexpr double pio2_1 = 1.57079632673412561417e+00;
+inline constexpr double pio2_2 = 6.07710050630396597660e-11;
+inline constexpr double pio2_2t = 2.02226624879595063154e-21;
+// больше этого аргументы в радианах сводятся через libm
+inline constexpr double reduction_limit = 1e5;
+// больше этого аргументы в градусах сначала сводятся по модулю 360 через std::fmod
+inline constexpr double degree_limit = 1e15;
+inline constexpr double deg_to_rad = M_PI / 180;
+
+// минимаксные коэффициенты синуса и косинуса на [-пи/4, пи/4] (fdlibm)
+inline constexpr double S1 = -1.66666666666666324348e-01;
+inline constexpr double S2 = 8.33333333332248946124e-03;
+inline constexpr double S3 = -1.98412698298579493134e-04;
+inline constexpr double S4 = 2.75573137070700676789e-06;
+inline constexpr double S5 = -2.50507602534068634195e-08;
+inline constexpr double S6 = 1.58969099521155010221e-10;
+inline constexpr double C1 = 4.16666666666666019037e-02;
+inline constexpr double C2 = -1.38888888888741095749e-03;
+inline constexpr double C3 = 2.48015872894767294178e-05;
+inline constexpr double C4 = -2.75573143513906633035e-07;
+inline constexpr double C5 = 2.08757232129817482790e-09;
+inline constexpr double C6 = -1.13596475577881948265e-11;
+
+// рациональная аппроксимация арктангенса на [0, 0.66] (Cephes)
+inline constexpr double P0 = -8.750608600031904122785e-01;
+inline constexpr double P1 = -1.615753718733365076637e+01;
+inline constexpr double P2 = -7.500855792314704667340e+01;
+inline constexpr double P3 = -1.228866684490136173410e+02;
+inline constexpr double P4 = -6.485021904942025371773e+01;
+inline constexpr double Q0 = 2.485846490142306297962e+01;
+inline constexpr double Q1 = 1.650270098316988542046e+02;
+inline constexpr double Q2 = 4.328810604912902668951e+02;
+inline constexpr double Q3 = 4.853903996359136964868e+02;
+inline constexpr double Q4 = 1.945506571482613964425e+02;
+// tan(3 пи / 8) и младшие биты пи / 2
+inline constexpr double tan_3pi_8 = 2.41421356237309504880;
+inline constexpr double morebits = 6.123233995736765886130e-17;
+
+// правильно округлённые sin 30°, cos 30°, sin 45°, tan 30°, tan 60°
+inline constexpr double sin_30 = 0.5;
+inline constexpr double cos_30 = 0.86602540378443864676;
+inline constexpr double sin_45 = 0.70710678118654752440;
+inline constexpr double tan_30 = 0.57735026918962576451;
+inline constexpr double tan_60 = 1.73205080756887729353;
+
+// тангенс меньше этого по модулю считается нулём, и котангенс - бесконечность
+inline constexpr double tan_eps = 1e-15;
+
+inline double round_to_integer(const double x)
+{
+    return (x + round_magic) - round_magic;
+}
+
+inline double sin_poly(const double r)
+{
+    const double z = r * r;
+    const double w = z * z;
+    const double p = S2 + z * (S3 + z * S4) + z * w * (S5 + z * S6);
+    return r + z * r * (S1 + z * p);
+}
+
+inline double cos_poly(const double r)
+{
+    const double z = r * r;
+    const double w = z * z;
+    const double p = z * (C1 + z * (C2 + z * C3)) + w * w * (C4 + z * (C5 + z * C6));
+    const double hz = 0.5 * z;
+    const double v = 1 - hz;
+    return v + (((1 - v) - hz) + z * p);
+}
+
+// x = q * пи / 2 + r, |r| <= пи / 4; quadrant - q по модулю 4 в [-2, 2]; |x| <= reduction_limit
+inline double reduce(const double x, double & quadrant)
+{
+    const double q = round_to_integer(x * two_over_pi);
+    quadrant = q - 4 * round_to_integer(q * 0.25);
+    return ((x - q * pio2_1) - q * pio2_2) - q * pio2_2t;
+}
+
+// x = q * 90 + r градусов, |r| <= 45 с точностью до округления x / 90; |x| <= degree_limit.
+// r вычисляется точно: 90 * q - целое меньше 2^53, и при q != 0 у x и r общий порядок младшего бита
+inline double reduce_degrees(const double x, double & quadrant)
+{
+    const double q = round_to_integer(x * (1.0 / 90));
+    quadrant = q - 4 * round_to_integer(q * 0.25);
+    return x - 90 * q;
+}
+
+// синус и косинус r градусов, |r| <= 45; при |r| = 30 и 45 - правильно округлённые
+inline double exact_sin_degrees(const double r, const double s)
+{
+    const double a = std::fabs(r);
+    const double exact = a == 30 ? sin_30 : sin_45;
+    return a == 30 || a == 45 ? (r < 0 ? -exact : exact) : s;
+}
+
+inline double exact_cos_degrees(const double r, const double c)
+{
+    const double a = std::fabs(r);
+    return a == 30 ? cos_30 : (a == 45 ? sin_45 : c);
+}
+
+// синус по s = sin r, c = cos r и четверти k в [-2, 3], косинус - то же при k на единицу больше;
+// 0 - result, чтобы точные нули в градусах (cos 90°, sin 180°) были +0
+inline double by_quadrant(const double s, const double c, const double k)
+{
+    const bool odd = k == 1 || k == -1 || k == 3;
+    const bool negative = k == 2 || k == -2 || k == -1 || k == 3;
+    const double result = odd ? c : s;
+    return negative ? 0 - result : result;
+}
+
+// в нечётной четверти -c / s; 0 - s вместо -s, чтобы тангенс 90° был +inf, а котангенс - +0
+inline double tan_by_quadrant(const double s, const double c, const double quadrant)
+{
+    const bool odd = quadrant == 1 || quadrant == -1;
+    return odd ? c / (0 - s) : s / c;
+}
+
+inline double invert_tan(const double t)
+{
+    return std::fabs(t) < tan_eps ? (t < 0 ? -INFINITY : INFINITY) : 1 / t;
+}
+
+// тангенс (или котангенс при cotangent) quadrant * 90 + r градусов; при |r| = 30 и 45 -
+// правильно округлённый, иначе v. В нечётной четверти tan = -ctn r, а ctn = -tan r
+inline double exact_tan_degrees(const double r, const double quadrant, const bool cotangent, const double v)
+{
+    const double a = std::fabs(r);
+    const bool odd = quadrant == 1 || quadrant == -1;
+    const double exact = a == 45 ? 1 : (odd != cotangent ? tan_60 : tan_30);
+    return a == 30 || a == 45 ? ((r < 0) != odd ? -exact : exact) : v;
+}
+
+inline double atan_poly(const double x)
+{
+    const double a = std::fabs(x);
+    const bool big = a > tan_3pi_8;
+    const bool middle = a > 0.66;
+    const double base = big ? M_PI_2 : (middle ? M_PI_4 : 0);
+    const double extra = big ? morebits : (middle ? 0.5 * morebits : 0);
+    const double t = big ? -1 / a : (middle ? (a - 1) / (a + 1) : a);
+    const double z = t * t;
+    const double p = (((P0 * z + P1) * z + P2) * z + P3) * z + P4;
+    const double q = ((((z + Q0) * z + Q1) * z + Q2) * z + Q3) * z + Q4;
+    const double r = base + ((t * (z * p / q) + t) + extra);
+    return x < 0 ? -r : r;
+}
+
+// asin x = atan(x / sqrt(1 - x^2)), 1 - x^2 раскладывается на множители, чтобы не терять точность у ±1
+inline double asin_poly(const double x)
+{
+    return atan_poly(x / std::sqrt((1 - x) * (1 + x)));
+}
+
+// acos x = 2 atan(sqrt((1 - x) / (1 + x)))
+inline double acos_poly(const double x)
+{
+    return 2 * atan_poly(std::sqrt((1 - x) / (1 + x)));
+}
+
+// actn x = atan(1 / x) при x > 0 и пи + atan(1 / x) при x < 0, значения в (0, пи)
+inline double actn_poly(const double x)
+{
+    // 1 / x отрицательно и при x = -0
+    const double t = 1 / x;
+    const double a = atan_poly(t);
+    return t < 0 ? M_PI + a : a;
+}
+
+inline double to_degrees(const double x)
+{
+    return 180 * x / M_PI;
+}
+
+// аркфункции в градусах от 0, ±0.5 и ±1 - точные целые
+inline double exact_asin_degrees(const double x, const double v)
+{
+    const double a = std::fabs(x);
+    const double exact = a == 0.5 ? 30 : 90;
+    return a == 0.5 || a == 1 ? (x < 0 ? -exact : exact) : v;
+}
+
+inline double exact_acos_degrees(const double x, const double v)
+{
+    const double exact = x == 0 ? 90 : (x == 0.5 ? 60 : (x == -0.5 ? 120 : (x == 1 ? 0 : 180)));
+    return x == 0 || x == 0.5 || x == -0.5 || x == 1 || x == -1 ? exact : v;
+}
+
+inline double exact_atan_degrees(const double x, const double v)
+{
+    return x == 1 ? 45 : (x == -1 ? -45 : v);
+}
+
+inline double exact_actn_degrees(const double x, const double v)
+{
+    return x == 1 ? 45 : (x == -1 ? 135 : (x == 0 ? 90 : v));
+}
+
+} // anonymous namespace
+
+} // namespace trig
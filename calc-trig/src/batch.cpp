@@ -0,0 +1,289 @@
+#include "calc.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Пакетное выполнение программ. Каждая операция - это цикл по блоку регистров без ветвлений
+// и вызовов libm, который компилятор векторизует; на x86-64 функции собираются дважды,
+// для AVX2 и для базового набора инструкций, и нужная версия выбирается при загрузке.
+// FMA не используется, поэтому обе версии дают одинаковые до бита результаты. Тригонометрия
+// собирается из тех же частей, что и скалярные ядра FAST из trig.h, и совпадает с ними.
+
+// резолверы клонов вызываются до инициализации TSan и MSan, под ними остаётся одна версия
+#if defined(__SANITIZE_THREAD__)
+#define CALC_NO_SIMD_CLONES
+#elif defined(__has_feature)
+#if __has_feature(thread_sanitizer) || __has_feature(memory_sanitizer)
+#define CALC_NO_SIMD_CLONES
+#endif
+#endif
+
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(CALC_NO_SIMD_CLONES)
+#define CALC_SIMD_CLONES __attribute__((target_clones("avx2", "default")))
+#else
+#define CALC_SIMD_CLONES
+#endif
+
+namespace {
+
+// регистры обрабатываются блоками, чтобы вся программа проходила по данным из кэша
+const std::size_t block_size = 1024;
+
+// аргументы, которые не сводятся в векторном цикле, пересчитываются скалярным ядром
+template <class F>
+void fix_large(const double * args, double * values, const std::size_t n, const double limit, F && f)
+{
+    for (std::size_t i = 0; i < n; ++i) {
+        if (!(std::fabs(args[i]) <= limit)) {
+            values[i] = f(args[i]);
+        }
+    }
+}
+
+CALC_SIMD_CLONES void sin_cos_radians(double * values, const std::size_t n, const bool cosine)
+{
+    const double shift = cosine ? 1 : 0;
+    for (std::size_t i = 0; i < n; ++i) {
+        double quadrant;
+        const double r = trig::reduce(values[i], quadrant);
+        values[i] = trig::by_quadrant(trig::sin_poly(r), trig::cos_poly(r), quadrant + shift);
+    }
+}
+
+CALC_SIMD_CLONES void sin_cos_degrees(double * values, const std::size_t n, const bool cosine)
+{
+    const double shift = cosine ? 1 : 0;
+    for (std::size_t i = 0; i < n; ++i) {
+        double quadrant;
+        const double r = trig::reduce_degrees(values[i], quadrant);
+        const double s = trig::exact_sin_degrees(r, trig::sin_poly(r * trig::deg_to_rad));
+        const double c = trig::exact_cos_degrees(r, trig::cos_poly(r * trig::deg_to_rad));
+        values[i] = trig::by_quadrant(s, c, quadrant + shift);
+    }
+}
+
+// с cotangent - котангенс, как и в process_line: обратный к тангенсу, почти нулевой тангенс даёт бесконечность
+CALC_SIMD_CLONES void tan_radians(double * values, const std::size_t n, const bool cotangent)
+{
+    for (std::size_t i = 0; i < n; ++i) {
+        double quadrant;
+        const double r = trig::reduce(values[i], quadrant);
+        const double t = trig::tan_by_quadrant(trig::sin_poly(r), trig::cos_poly(r), quadrant);
+        values[i] = cotangent ? trig::invert_tan(t) : t;
+    }
+}
+
+CALC_SIMD_CLONES void tan_degrees(double * values, const std::size_t n, const bool cotangent)
+{
+    for (std::size_t i = 0; i < n; ++i) {
+        double quadrant;
+        const double r = trig::reduce_degrees(values[i], quadrant);
+        const double radians = r * trig::deg_to_rad;
+        const double t = trig::tan_by_quadrant(trig::sin_poly(radians), trig::cos_poly(radians), quadrant);
+        values[i] = trig::exact_tan_degrees(r, quadrant, cotangent, cotangent ? trig::invert_tan(t) : t);
+    }
+}
+
+CALC_SIMD_CLONES void arc_radians(const Op op, double * values, const std::size_t n)
+{
+    switch (op) {
+    case Op::ASIN:
+        for (std::size_t i = 0; i < n; ++i) {
+            values[i] = trig::asin_poly(values[i]);
+        }
+        break;
+    case Op::ACOS:
+        for (std::size_t i = 0; i < n; ++i) {
+            values[i] = trig::acos_poly(values[i]);
+        }
+        break;
+    case Op::ATAN:
+        for (std::size_t i = 0; i < n; ++i) {
+            values[i] = trig::atan_poly(values[i]);
+        }
+        break;
+    default:
+        for (std::size_t i = 0; i < n; ++i) {
+            values[i] = trig::actn_poly(values[i]);
+        }
+        break;
+    }
+}
+
+CALC_SIMD_CLONES void arc_degrees(const Op op, double * values, const std::size_t n)
+{
+    switch (op) {
+    case Op::ASIN:
+        for (std::size_t i = 0; i < n; ++i) {
+            values[i] = trig::exact_asin_degrees(values[i], trig::to_degrees(trig::asin_poly(values[i])));
+        }
+        break;
+    case Op::ACOS:
+        for (std::size_t i = 0; i < n; ++i) {
+            values[i] = trig::exact_acos_degrees(values[i], trig::to_degrees(trig::acos_poly(values[i])));
+        }
+        break;
+    case Op::ATAN:
+        for (std::size_t i = 0; i < n; ++i) {
+            values[i] = trig::exact_atan_degrees(values[i], trig::to_degrees(trig::atan_poly(values[i])));
+        }
+        break;
+    default:
+        for (std::size_t i = 0; i < n; ++i) {
+            values[i] = trig::exact_actn_degrees(values[i], trig::to_degrees(trig::actn_poly(values[i])));
+        }
+        break;
+    }
+}
+
+CALC_SIMD_CLONES void sqrt_lanes(double * values, std::uint8_t * errors, const std::size_t n)
+{
+    for (std::size_t i = 0; i < n; ++i) {
+        const double x = values[i];
+        const bool good = x >= 0;
+        values[i] = good ? std::sqrt(x) : x;
+        errors[i] |= good ? LANE_OK : LANE_BAD_SQRT;
+    }
+}
+
+CALC_SIMD_CLONES void arithmetic(const Op op, const double arg, double * values, const std::size_t n)
+{
+    switch (op) {
+    case Op::SET: std::fill(values, values + n, arg); break;
+    case Op::ADD:
+        for (std::size_t i = 0; i < n; ++i) {
+            values[i] += arg;
+        }
+        break;
+    case Op::SUB:
+        for (std::size_t i = 0; i < n; ++i) {
+            values[i] -= arg;
+        }
+        break;
+    case Op::MUL:
+        for (std::size_t i = 0; i < n; ++i) {
+            values[i] *= arg;
+        }
+        break;
+    case Op::DIV:
+        for (std::size_t i = 0; i < n; ++i) {
+            values[i] /= arg;
+        }
+        break;
+    case Op::NEG:
+        for (std::size_t i = 0; i < n; ++i) {
+            values[i] = -values[i];
+        }
+        break;
+    default: break;
+    }
+}
+
+void mark(std::uint8_t * errors, const std::size_t n, const LaneError error)
+{
+    for (std::size_t i = 0; i < n; ++i) {
+        errors[i] |= error;
+    }
+}
+
+void trig_lanes(const Op op, double * values, const std::size_t n, const bool rad_on)
+{
+    double args[block_size];
+    std::copy(values, values + n, args);
+    const double limit = rad_on ? trig::reduction_limit : trig::degree_limit;
+    switch (op) {
+    case Op::SIN:
+    case Op::COS: {
+        const bool cosine = op == Op::COS;
+        if (rad_on) {
+            sin_cos_radians(values, n, cosine);
+        }
+        else {
+            sin_cos_degrees(values, n, cosine);
+        }
+        fix_large(args, values, n, limit, [rad_on, cosine](const double x) {
+            return cosine ? trig::cos(x, rad_on, Precision::FAST) : trig::sin(x, rad_on, Precision::FAST);
+        });
+        break;
+    }
+    default: {
+        const bool cotangent = op == Op::CTN;
+        if (rad_on) {
+            tan_radians(values, n, cotangent);
+        }
+        else {
+            tan_degrees(values, n, cotangent);
+        }
+        fix_large(args, values, n, limit, [rad_on, cotangent](const double x) {
+            return cotangent ? trig::ctn(x, rad_on, Precision::FAST) : trig::tan(x, rad_on, Precision::FAST);
+        });
+        break;
+    }
+    }
+}
+
+void apply(const Instruction & instruction, double * values, std::uint8_t * errors, const std::size_t n, bool & rad_on)
+{
+    switch (instruction.op) {
+    case Op::DIV:
+        if (instruction.arg == 0) {
+            mark(errors, n, LANE_BAD_DIVISOR);
+            break;
+        }
+        arithmetic(instruction.op, instruction.arg, values, n);
+        break;
+    case Op::REM:
+        if (instruction.arg == 0) {
+            mark(errors, n, LANE_BAD_REMAINDER);
+            break;
+        }
+        for (std::size_t i = 0; i < n; ++i) {
+            values[i] = std::fmod(values[i], instruction.arg);
+        }
+        break;
+    case Op::POW:
+        for (std::size_t i = 0; i < n; ++i) {
+            values[i] = std::pow(values[i], instruction.arg);
+        }
+        break;
+    case Op::SQRT: sqrt_lanes(values, errors, n); break;
+    case Op::SIN:
+    case Op::COS:
+    case Op::TAN:
+    case Op::CTN: trig_lanes(instruction.op, values, n, rad_on); break;
+    case Op::ASIN:
+    case Op::ACOS:
+    case Op::ATAN:
+    case Op::ACTN:
+        if (rad_on) {
+            arc_radians(instruction.op, values, n);
+        }
+        else {
+            arc_degrees(instruction.op, values, n);
+        }
+        break;
+    case Op::RAD: rad_on = true; break;
+    case Op::DEG: rad_on = false; break;
+    default: arithmetic(instruction.op, instruction.arg, values, n); break;
+    }
+}
+
+} // anonymous namespace
+
+void execute(const Program & program, double * registers, const std::size_t n, bool & rad_on, std::uint8_t * errors)
+{
+    std::fill(errors, errors + n, LANE_OK);
+    const bool initial = rad_on;
+    for (std::size_t first = 0; first < n; first += block_size) {
+        const std::size_t size = std::min(block_size, n - first);
+        rad_on = initial;
+        for (const auto & instruction : program) {
+            apply(instruction, registers + first, errors + first, size, rad_on);
+        }
+    }
+    if (n == 0) {
+        for (const auto & instruction : program) {
+            apply(instruction, registers, errors, 0, rad_on);
+        }
+    }
+}
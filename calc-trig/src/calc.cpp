@@ -1,38 +1,17 @@
 #include "calc.h"
 
+#include "stats.h"
+
+#include <atomic>
 #include <cctype>   // for std::isspace
 #include <cmath>    // various math functions
+#include <cstdint>
 #include <iostream> // for error reporting via std::cerr
 #include <vector>
 
 namespace {
 
 const std::size_t max_decimal_digits = 10;
-const double eps = 1e-15;
-
-enum class Op
-{
-    ERR,
-    SET,
-    ADD,
-    SUB,
-    MUL,
-    DIV,
-    REM,
-    NEG,
-    POW,
-    SQRT,
-    SIN,
-    COS,
-    TAN,
-    CTN,
-    ASIN,
-    ACOS,
-    ATAN,
-    ACTN,
-    RAD,
-    DEG
-};
 
 std::size_t arity(const Op op)
 {
@@ -71,40 +50,108 @@ bool is_digit(const char symbol)
     return symbol >= '0' && symbol <= '9';
 }
 
-Op parse_string_op(const std::string & line, std::size_t & i)
+// Мнемоники различаются уже первыми тремя буквами, поэтому по ним выбирается единственный
+// кандидат, который остаётся сравнить целиком. Три буквы переводятся в ячейку таблицы
+// мультипликативным хешем, множитель для которого без коллизий подбирается при компиляции.
+struct Mnemonic
 {
-    const auto test = [&i, &line](const std::string & s) {
-        for (std::size_t back = 0; back < s.size(); ++back) {
-            std::size_t index = i + back;
-            if (index >= line.size() || line[index] != s[back]) {
-                return false;
-            }
+    std::string_view name;
+    Op op = Op::ERR;
+};
+
+constexpr Mnemonic mnemonics[]{
+        {"SQRT", Op::SQRT},
+        {"SIN", Op::SIN},
+        {"COS", Op::COS},
+        {"TAN", Op::TAN},
+        {"CTN", Op::CTN},
+        {"ASIN", Op::ASIN},
+        {"ACOS", Op::ACOS},
+        {"ATAN", Op::ATAN},
+        {"ACTN", Op::ACTN},
+        {"DEG", Op::DEG},
+        {"RAD", Op::RAD}};
+
+constexpr std::size_t key_size = 3;
+constexpr unsigned hash_bits = 4;
+constexpr std::size_t table_size = std::size_t{1} << hash_bits;
+
+constexpr std::uint32_t key(const std::string_view s)
+{
+    return static_cast<std::uint32_t>(static_cast<unsigned char>(s[0])) |
+            static_cast<std::uint32_t>(static_cast<unsigned char>(s[1])) << 8 |
+            static_cast<std::uint32_t>(static_cast<unsigned char>(s[2])) << 16;
+}
+
+constexpr std::size_t slot(const std::uint32_t key, const std::uint32_t multiplier)
+{
+    return (key * multiplier) >> (32 - hash_bits);
+}
+
+constexpr bool is_perfect(const std::uint32_t multiplier)
+{
+    bool used[table_size]{};
+    for (const auto & mnemonic : mnemonics) {
+        if (mnemonic.name.size() < key_size) {
+            return false;
         }
-        i += s.size();
-        return true;
-    };
-    const std::vector<std::pair<std::string, Op>> operations{
-            {"SQRT", Op::SQRT},
-            {"SIN", Op::SIN},
-            {"COS", Op::COS},
-            {"TAN", Op::TAN},
-            {"CTN", Op::CTN},
-            {"ASIN", Op::ASIN},
-            {"ACOS", Op::ACOS},
-            {"ATAN", Op::ATAN},
-            {"ACTN", Op::ACTN},
-            {"DEG", Op::DEG},
-            {"RAD", Op::RAD}};
-    for (const auto & operation : operations) {
-        if (test(operation.first)) {
-            return operation.second;
+        const auto i = slot(key(mnemonic.name), multiplier);
+        if (used[i]) {
+            return false;
         }
+        used[i] = true;
+    }
+    return true;
+}
+
+constexpr std::uint32_t find_multiplier()
+{
+    for (std::uint32_t multiplier = 1; multiplier < (1u << 20); multiplier += 2) {
+        if (is_perfect(multiplier)) {
+            return multiplier;
+        }
+    }
+    return 0;
+}
+
+constexpr std::uint32_t multiplier = find_multiplier();
+static_assert(multiplier != 0, "mnemonics need a larger table or a longer key");
+
+struct MnemonicTable
+{
+    Mnemonic slots[table_size];
+};
+
+constexpr MnemonicTable make_table()
+{
+    MnemonicTable table{};
+    for (const auto & mnemonic : mnemonics) {
+        table.slots[slot(key(mnemonic.name), multiplier)] = mnemonic;
     }
-    return Op::ERR;
+    return table;
 }
 
-Op parse_op(const std::string & line, std::size_t & i)
+constexpr MnemonicTable mnemonic_table = make_table();
+
+Op parse_string_op(const std::string_view line, std::size_t & i)
+{
+    if (line.size() - i < key_size) {
+        return Op::ERR;
+    }
+    const auto & mnemonic = mnemonic_table.slots[slot(key(line.substr(i)), multiplier)];
+    // у пустых ячеек op - ERR, так что проверять их отдельно не нужно
+    if (line.compare(i, mnemonic.name.size(), mnemonic.name) != 0) {
+        return Op::ERR;
+    }
+    i += mnemonic.name.size();
+    return mnemonic.op;
+}
+
+Op parse_op(const std::string_view line, std::size_t & i)
 {
+    if (i >= line.size()) {
+        return Op::ERR;
+    }
     if (is_digit(line[i])) {
         return Op::SET;
     }
@@ -125,15 +172,11 @@ Op parse_op(const std::string & line, std::size_t & i)
         return Op::POW;
     default:
         --i;
-        Op op = parse_string_op(line, i);
-        if (op == Op::ERR) {
-            std::cerr << "Unknown operation " << line << std::endl;
-        }
-        return op;
+        return parse_string_op(line, i);
     }
 }
 
-std::size_t skip_ws(const std::string & line, std::size_t i)
+std::size_t skip_ws(const std::string_view line, std::size_t i)
 {
     while (i < line.size() && std::isspace(line[i])) {
         ++i;
@@ -141,7 +184,7 @@ std::size_t skip_ws(const std::string & line, std::size_t i)
     return i;
 }
 
-double parse_arg(const std::string & line, std::size_t & i)
+double parse_arg(const std::string_view line, std::size_t & i, Error & error)
 {
     double res = 0;
     std::size_t count = 0;
@@ -181,75 +224,51 @@ double parse_arg(const std::string & line, std::size_t & i)
         }
     }
     if (!good) {
-        std::cerr << "Argument parsing error at " << i << ": '" << line.substr(i) << "'" << std::endl;
+        error = Error::BAD_ARGUMENT;
     }
     else if (i < line.size()) {
-        std::cerr << "Argument isn't fully parsed, suffix left: '" << line.substr(i) << "'" << std::endl;
+        error = Error::ARGUMENT_SUFFIX;
     }
     return res;
 }
 
-// тригонометрические функции всегда принимают аргумент в радианах
-// эта функция преобразует градусы в радины, если сейчас вычисления происходят в градусах
-double cast_trig_arg(const double number, const bool rad_on)
-{
-    if (!rad_on) {
-        return M_PI * number / 180;
-    }
-    return number;
-}
-
-// тригонометрические аркфункции всегда возвращают результат в радианах
-// эта функция преобразует радианы в градусы, если сейчас вычисления происходят в градусах
-double cast_arc_trig_result(const double number, const bool rad_on)
-{
-    if (!rad_on) {
-        return 180 * number / M_PI;
-    }
-    return number;
-}
+// выбирается один раз до начала вычислений, но читается и из потоков replay
+std::atomic<Precision> trig_precision{Precision::PRECISE};
 
-double unary(const double current, const Op op, const bool rad_on)
+double unary(const double current, const Op op, const bool rad_on, Error & error)
 {
+    const Precision precision = trig_precision.load(std::memory_order_relaxed);
     switch (op) {
     case Op::NEG:
         return -current;
     case Op::SIN:
-        return std::sin(cast_trig_arg(current, rad_on));
+        return trig::sin(current, rad_on, precision);
     case Op::COS:
-        return std::cos(cast_trig_arg(current, rad_on));
+        return trig::cos(current, rad_on, precision);
     case Op::TAN:
-        return std::tan(cast_trig_arg(current, rad_on));
-    case Op::CTN: {
-        const double t = std::tan(cast_trig_arg(current, rad_on));
-        if (std::fabs(t) < eps) {
-            if (t < 0) {
-                return -INFINITY;
-            }
-            return INFINITY;
-        }
-        return 1 / t;
-    }
+        return trig::tan(current, rad_on, precision);
+    case Op::CTN:
+        return trig::ctn(current, rad_on, precision);
     case Op::ASIN:
-        return cast_arc_trig_result(std::asin(current), rad_on);
+        return trig::asin(current, rad_on, precision);
     case Op::ACOS:
-        return cast_arc_trig_result(std::acos(current), rad_on);
+        return trig::acos(current, rad_on, precision);
     case Op::ATAN:
-        return cast_arc_trig_result(std::atan(current), rad_on);
+        return trig::atan(current, rad_on, precision);
     case Op::ACTN:
-        return cast_arc_trig_result(M_PI_2 - std::atan(current), rad_on);
+        return trig::actn(current, rad_on, precision);
     case Op::SQRT:
         if (current >= 0) {
             return std::sqrt(current);
         }
-        std::cerr << "Bad argument for SQRT: " << current << std::endl;
+        error = Error::BAD_SQRT;
         [[fallthrough]];
     default:
         return current;
     }
 }
 
-double binary(const Op op, const double left, const double right)
+double binary(const Op op, const double left, const double right, Error & error)
 {
     switch (op) {
     case Op::SET:
@@ -265,7 +284,7 @@ double binary(const Op op, const double left, const double right)
             return left / right;
         }
         else {
-            std::cerr << "Bad right argument for division: " << right << std::endl;
+            error = Error::BAD_DIVISOR;
             return left;
         }
     case Op::REM:
@@ -273,7 +292,7 @@ double binary(const Op op, const double left, const double right)
             return std::fmod(left, right);
         }
         else {
-            std::cerr << "Bad right argument for remainder: " << right << std::endl;
+            error = Error::BAD_REMAINDER;
             return left;
         }
     case Op::POW:
@@ -296,36 +315,191 @@ double nullary(const double current, const Op op, bool & rad_on)
 
 } // anonymous namespace
 
-double process_line(const double current, bool & rad_on, const std::string & line)
+// один переход по op вместо разбора arity, чтобы цикл execute оставался коротким
+double dispatch(const Instruction & instruction, const double current, bool & rad_on, Error & error)
+{
+    switch (instruction.op) {
+    case Op::SET:
+    case Op::ADD:
+    case Op::SUB:
+    case Op::MUL:
+    case Op::DIV:
+    case Op::REM:
+    case Op::POW:
+        return binary(instruction.op, current, instruction.arg, error);
+    case Op::NEG:
+    case Op::SQRT:
+    case Op::SIN:
+    case Op::COS:
+    case Op::TAN:
+    case Op::CTN:
+    case Op::ASIN:
+    case Op::ACOS:
+    case Op::ATAN:
+    case Op::ACTN:
+        return unary(current, instruction.op, rad_on, error);
+    case Op::RAD:
+    case Op::DEG:
+        return nullary(current, instruction.op, rad_on);
+    default:
+        return current;
+    }
+}
+
+Error parse_line(const std::string_view line, Instruction & instruction, std::size_t & position)
 {
     std::size_t i = 0;
     const auto op = parse_op(line, i);
+    position = i;
     switch (arity(op)) {
     case 2: {
         i = skip_ws(line, i);
         const auto old_i = i;
-        const auto arg = parse_arg(line, i);
+        Error error = Error::NONE;
+        const auto arg = parse_arg(line, i, error);
+        position = i;
         if (i == old_i) {
-            std::cerr << "No argument for a binary operation" << std::endl;
-            break;
+            return Error::NO_ARGUMENT;
         }
-        else if (i < line.size()) {
-            break;
+        else if (error != Error::NONE) {
+            return error;
         }
-        return binary(op, current, arg);
+        instruction = {op, arg};
+        return Error::NONE;
     }
     case 1: {
         if (i < line.size()) {
-            std::cerr << "Unexpected suffix for a unary operation: '" << line.substr(i) << "'" << std::endl;
-            break;
+            return Error::UNARY_SUFFIX;
         }
-        return unary(current, op, rad_on);
+        instruction = {op, 0};
+        return Error::NONE;
     }
     case 0: {
-        // передаётся current, так как в теории он может потребоваться какой-то нульарной функции
-        return nullary(current, op, rad_on);
+        instruction = {op, 0};
+        return Error::NONE;
+    }
+    default: return Error::UNKNOWN_OPERATION;
     }
-    default: break;
+}
+
+double step(const Instruction & instruction, const double current, bool & rad_on, Error & error)
+{
+    const auto start = stats::now();
+    const double result = dispatch(instruction, current, rad_on, error);
+    stats::record(instruction.op, start);
+    return result;
+}
+
+void set_precision(const Precision precision)
+{
+    trig_precision.store(precision, std::memory_order_relaxed);
+}
+
+Result process_line(const double current, bool & rad_on, const std::string_view line)
+{
+    Instruction instruction{Op::ERR, 0};
+    std::size_t position = 0;
+    const Error error = parse_line(line, instruction, position);
+    if (error != Error::NONE) {
+        return {current, error, position};
+    }
+    Result result{current, Error::NONE, line.size()};
+    result.value = step(instruction, current, rad_on, result.error);
+    return result;
+}
+
+void report(std::ostream & log, const std::string_view line, const Result & result)
+{
+    const std::size_t i = result.position;
+    if (result.error != Error::NONE) {
+        stats::record(result.error);
+    }
+    switch (result.error) {
+    case Error::NONE: break;
+    case Error::UNKNOWN_OPERATION:
+        log << "Unknown operation " << line << std::endl;
+        break;
+    case Error::NO_ARGUMENT:
+        // аргумент начинается с недопустимого символа
+        if (i < line.size()) {
+            log << "Argument parsing error at " << i << ": '" << line.substr(i) << "'" << std::endl;
+        }
+        log << "No argument for a binary operation" << std::endl;
+        break;
+    case Error::BAD_ARGUMENT:
+        log << "Argument parsing error at " << i << ": '" << line.substr(i) << "'" << std::endl;
+        break;
+    case Error::ARGUMENT_SUFFIX:
+        log << "Argument isn't fully parsed, suffix left: '" << line.substr(i) << "'" << std::endl;
+        break;
+    case Error::UNARY_SUFFIX:
+        log << "Unexpected suffix for a unary operation: '" << line.substr(i) << "'" << std::endl;
+        break;
+    case Error::BAD_DIVISOR:
+        log << "Bad right argument for division: " << 0.0 << std::endl;
+        break;
+    case Error::BAD_REMAINDER:
+        log << "Bad right argument for remainder: " << 0.0 << std::endl;
+        break;
+    case Error::BAD_SQRT:
+        log << "Bad argument for SQRT: " << result.value << std::endl;
+        break;
+    }
+}
+
+bool parse_line(const std::string_view line, Instruction & instruction, std::ostream & log)
+{
+    std::size_t position = 0;
+    const Error error = parse_line(line, instruction, position);
+    if (error != Error::NONE) {
+        report(log, line, {0, error, position});
+        return false;
+    }
+    return true;
+}
+
+double step(const Instruction & instruction, const double current, bool & rad_on, std::ostream & log)
+{
+    Result result{current, Error::NONE, 0};
+    result.value = step(instruction, current, rad_on, result.error);
+    report(log, {}, result);
+    return result.value;
+}
+
+Program compile(const std::string & script)
+{
+    Program program;
+    std::size_t first = 0;
+    while (first < script.size()) {
+        auto last = script.find('\n', first);
+        if (last == std::string::npos) {
+            last = script.size();
+        }
+        Instruction instruction{Op::ERR, 0};
+        if (parse_line(std::string_view(script).substr(first, last - first), instruction, std::cerr)) {
+            program.push_back(instruction);
+        }
+        first = last + 1;
+    }
+    return program;
+}
+
+double execute(const Program & program, double current, bool & rad_on)
+{
+    for (const auto & instruction : program) {
+        current = step(instruction, current, rad_on, std::cerr);
     }
     return current;
 }
+
+double process_line(const double current, bool & rad_on, const std::string & line)
+{
+    const Result result = process_line(current, rad_on, std::string_view(line));
+    report(std::cerr, line, result);
+    return result.value;
+}
+
+double process_line(const double current, bool & rad_on, const char * line)
+{
+    return process_line(current, rad_on, std::string(line));
+}
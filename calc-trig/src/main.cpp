@@ -1,9 +1,181 @@
 #include "calc.h"
 
+#include "stats.h"
+
+#include <charconv>
+#include <cstdio>
+#include <cstring>
 #include <iostream>
+#include <sstream>
 #include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// объём лога, который параллельный режим держит в памяти
+const std::size_t block_size = 64 << 20;
+// блоки чтения и записи потокового режима
+const std::size_t input_size = 1 << 20;
+const std::size_t output_size = 1 << 20;
+// наибольшее число потоков --parallel
+const std::size_t max_threads = 1024;
+
+// Буфер вывода потокового режима, пишется в файл целыми блоками. Числа форматируются
+// to_chars так же, как operator<< с точностью по умолчанию (%.6g).
+class Output
+{
+public:
+    explicit Output(std::FILE * file_)
+        : file(file_)
+        , buffer(output_size)
+    {
+    }
+
+    ~Output() { flush(); }
+
+    void value(const double x)
+    {
+        reserve(32);
+        const auto result = std::to_chars(buffer.data() + size, buffer.data() + buffer.size(), x, std::chars_format::general, 6);
+        size = static_cast<std::size_t>(result.ptr - buffer.data());
+        buffer[size++] = '\n';
+    }
+
+    // каждое сообщение - строка, заканчивающаяся '\n', оно становится записью "error: сообщение"
+    void errors(const std::string_view messages)
+    {
+        static constexpr std::string_view prefix = "error: ";
+
+        std::size_t first = 0;
+        while (first < messages.size()) {
+            std::size_t last = messages.find('\n', first);
+            last = last == std::string_view::npos ? messages.size() : last;
+            append(prefix);
+            append(messages.substr(first, last - first));
+            append("\n");
+            first = last + 1;
+        }
+    }
+
+    void flush()
+    {
+        std::fwrite(buffer.data(), 1, size, file);
+        std::fflush(file);
+        size = 0;
+    }
+
+private:
+    void reserve(const std::size_t n)
+    {
+        if (buffer.size() - size < n) {
+            flush();
+        }
+        if (buffer.size() < n) {
+            buffer.resize(n);
+        }
+    }
+
+    void append(const std::string_view text)
+    {
+        reserve(text.size());
+        std::memcpy(buffer.data() + size, text.data(), text.size());
+        size += text.size();
+    }
+
+    std::FILE * file;
+    std::vector<char> buffer;
+    std::size_t size = 0;
+};
+
+// то же, что построчный цикл в main, но ввод читается блоками, строки разбираются прямо в буфере
+// чтения, а значения и сообщения об ошибках в порядке строк пишутся в один буферизованный вывод
+int stream_lines()
+{
+    double current = 0;
+    bool rad_on = false;
+    Output output(stdout);
+    std::ostringstream errors;
+    const auto process = [&](const std::string_view line) {
+        const Result result = process_line(current, rad_on, line);
+        if (result.error != Error::NONE) {
+            report(errors, line, result);
+            output.errors(errors.str());
+            errors.str({});
+        }
+        current = result.value;
+        output.value(current);
+    };
 
-int main()
+    std::vector<char> input(input_size);
+    // [first, last) - ещё не разобранная часть буфера
+    std::size_t first = 0;
+    std::size_t last = 0;
+    while (true) {
+        if (first > 0) {
+            std::memmove(input.data(), input.data() + first, last - first);
+            last -= first;
+            first = 0;
+        }
+        // строка длиннее буфера
+        if (last == input.size()) {
+            input.resize(input.size() * 2);
+        }
+        const std::size_t read = std::fread(input.data() + last, 1, input.size() - last, stdin);
+        if (read == 0) {
+            break;
+        }
+        last += read;
+        while (const auto * end = static_cast<const char *>(std::memchr(input.data() + first, '\n', last - first))) {
+            const auto length = static_cast<std::size_t>(end - input.data()) - first;
+            process(std::string_view(input.data() + first, length));
+            first += length + 1;
+        }
+    }
+    // последняя строка без '\n'
+    if (first < last) {
+        process(std::string_view(input.data() + first, last - first));
+    }
+    return 0;
+}
+
+int replay_blocks(const std::size_t threads)
+{
+    double current = 0;
+    bool rad_on = false;
+    std::string text;
+    std::string buffer(block_size, '\0');
+    while (std::cin.read(buffer.data(), static_cast<std::streamsize>(buffer.size())) || std::cin.gcount() > 0) {
+        text.append(buffer.data(), static_cast<std::size_t>(std::cin.gcount()));
+        // строка, которая ещё не дочитана, переходит в следующий блок
+        const auto end = text.rfind('\n');
+        if (end == std::string::npos) {
+            continue;
+        }
+        const std::string rest = text.substr(end + 1);
+        text.resize(end + 1);
+        current = replay(text, current, rad_on, std::cout, std::cerr, threads);
+        text = rest;
+    }
+    replay(text, current, rad_on, std::cout, std::cerr, threads);
+    std::cout.flush();
+    return 0;
+}
+
+// число потоков из аргумента --parallel: десятичное число от 1 до max_threads без лишних символов
+bool parse_threads(const std::string_view text, std::size_t & threads)
+{
+    std::size_t value = 0;
+    const auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (ec != std::errc() || ptr != text.data() + text.size() || value < 1 || value > max_threads) {
+        return false;
+    }
+    threads = value;
+    return true;
+}
+
+int process_lines()
 {
     double current = 0;
     bool rad_on = false;
@@ -11,4 +183,43 @@ int main()
         current = process_line(current, rad_on, line);
         std::cout << current << std::endl;
     }
+    return 0;
+}
+
+} // anonymous namespace
+
+// calc_trig [--fast] [--stats] [--stream | --parallel [threads]]
+int main(int argc, char ** argv)
+{
+    bool print_stats = false;
+    for (; argc > 1; --argc, ++argv) {
+        if (std::strcmp(argv[1], "--fast") == 0) {
+            set_precision(Precision::FAST);
+        }
+        else if (std::strcmp(argv[1], "--stats") == 0) {
+            print_stats = true;
+        }
+        else {
+            break;
+        }
+    }
+    int code = 0;
+    if (argc > 1 && std::strcmp(argv[1], "--stream") == 0) {
+        code = stream_lines();
+    }
+    else if (argc > 1 && std::strcmp(argv[1], "--parallel") == 0) {
+        std::size_t threads = std::thread::hardware_concurrency();
+        if (argc > 2 && !parse_threads(argv[2], threads)) {
+            std::cerr << "usage: calc_trig [--fast] [--stats] [--stream | --parallel [threads]], threads from 1 to " << max_threads << std::endl;
+            return 1;
+        }
+        code = replay_blocks(threads);
+    }
+    else {
+        code = process_lines();
+    }
+    if (print_stats) {
+        stats::print(std::cerr);
+    }
+    return code;
 }
@@ -0,0 +1,175 @@
+#include "calc.h"
+
+#include <iterator>
+
+namespace {
+
+bool is_trig(const Op op)
+{
+    switch (op) {
+    case Op::SIN:
+    case Op::COS:
+    case Op::TAN:
+    case Op::CTN:
+    case Op::ASIN:
+    case Op::ACOS:
+    case Op::ATAN:
+    case Op::ACTN: return true;
+    default: return false;
+    }
+}
+
+bool is_mode(const Op op)
+{
+    return op == Op::RAD || op == Op::DEG;
+}
+
+// Значение регистра перед последним SET ни на что не влияет, а после него известно и вычисляется
+// до первой тригонометрической операции, которой нужен ещё не известный режим. RAD и DEG
+// из отброшенной части остаются: они ещё понадобятся.
+Program fold_constants(const Program & program)
+{
+    std::size_t last_set = program.size();
+    for (std::size_t i = 0; i < program.size(); ++i) {
+        if (program[i].op == Op::SET) {
+            last_set = i;
+        }
+    }
+    if (last_set == program.size()) {
+        return program;
+    }
+    Program result;
+    for (std::size_t i = 0; i < last_set; ++i) {
+        if (is_mode(program[i].op)) {
+            result.push_back(program[i]);
+        }
+    }
+    double value = program[last_set].arg;
+    std::size_t i = last_set + 1;
+    for (; i < program.size() && !is_trig(program[i].op); ++i) {
+        if (is_mode(program[i].op)) {
+            result.push_back(program[i]);
+            continue;
+        }
+        bool rad_on = false;
+        Error error = Error::NONE;
+        value = dispatch(program[i], value, rad_on, error);
+    }
+    result.push_back({Op::SET, value});
+    result.insert(result.end(), std::next(program.begin(), static_cast<std::ptrdiff_t>(i)), program.end());
+    return result;
+}
+
+// Режим нужен только тригонометрическим операциям и вызывающему в конце, поэтому RAD и DEG
+// переносятся вперёд до ближайшей из них и остаются, только если меняют режим.
+Program collapse_modes(const Program & program)
+{
+    Program result;
+    const Instruction * known = nullptr;
+    const Instruction * pending = nullptr;
+    const auto flush = [&] {
+        if (pending != nullptr && (known == nullptr || known->op != pending->op)) {
+            result.push_back(*pending);
+            known = pending;
+        }
+        pending = nullptr;
+    };
+    for (const auto & instruction : program) {
+        if (is_mode(instruction.op)) {
+            pending = &instruction;
+            continue;
+        }
+        if (is_trig(instruction.op)) {
+            flush();
+        }
+        result.push_back(instruction);
+    }
+    flush();
+    return result;
+}
+
+bool is_identity(const Instruction & instruction)
+{
+    // x + 0 не тождественно: -0 + 0 = +0
+    return ((instruction.op == Op::MUL || instruction.op == Op::DIV) && instruction.arg == 1) ||
+            (instruction.op == Op::SUB && instruction.arg == 0);
+}
+
+bool is_additive(const Instruction & instruction)
+{
+    return instruction.op == Op::ADD || instruction.op == Op::SUB;
+}
+
+double addend(const Instruction & instruction)
+{
+    return instruction.op == Op::ADD ? instruction.arg : -instruction.arg;
+}
+
+// деление на 0 не меняет регистр, а только сообщает об ошибке, и в свёртку не входит
+bool is_multiplicative(const Instruction & instruction)
+{
+    return instruction.op == Op::MUL || instruction.op == Op::NEG || (instruction.op == Op::DIV && instruction.arg != 0);
+}
+
+double factor(const Instruction & instruction)
+{
+    switch (instruction.op) {
+    case Op::MUL: return instruction.arg;
+    case Op::NEG: return -1;
+    default: return 1 / instruction.arg;
+    }
+}
+
+Instruction add(const double value)
+{
+    return value < 0 ? Instruction{Op::SUB, -value} : Instruction{Op::ADD, value};
+}
+
+// каждая инструкция сравнивается с последней оставленной, так что сокращения идут цепочкой: _ * 1 _ -> пусто
+Program peephole(const Program & program, const bool reassociate)
+{
+    Program result;
+    for (const auto & instruction : program) {
+        if (is_identity(instruction)) {
+            continue;
+        }
+        if (result.empty()) {
+            result.push_back(instruction);
+            continue;
+        }
+        Instruction & back = result.back();
+        if (instruction.op == Op::NEG && back.op == Op::NEG) {
+            result.pop_back();
+        }
+        else if (reassociate && is_additive(instruction) && is_additive(back)) {
+            const double sum = addend(back) + addend(instruction);
+            result.pop_back();
+            if (sum != 0) {
+                result.push_back(add(sum));
+            }
+        }
+        else if (reassociate && is_multiplicative(instruction) && is_multiplicative(back)) {
+            const double product = factor(back) * factor(instruction);
+            result.pop_back();
+            if (product == -1) {
+                result.push_back({Op::NEG, 0});
+            }
+            else if (product != 1) {
+                result.push_back({Op::MUL, product});
+            }
+        }
+        else {
+            result.push_back(instruction);
+        }
+    }
+    return result;
+}
+
+} // anonymous namespace
+
+std::size_t optimize(Program & program, const bool reassociate)
+{
+    const std::size_t size = program.size();
+    program = peephole(collapse_modes(fold_constants(program)), reassociate);
+    return size - program.size();
+}
@@ -0,0 +1,319 @@
+#include "calc.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <sstream>
+#include <thread>
+
+namespace {
+
+// кусков больше, чем потоков, чтобы куски с тяжёлыми операциями не задерживали остальные
+const std::size_t chunks_per_thread = 8;
+
+enum class Mode
+{
+    INHERITED,
+    RAD,
+    DEG
+};
+
+// запас на округления серии: промежуточные значения, ограниченные им, не переполняются
+const double magnitude_limit = std::numeric_limits<double>::max() / 2;
+
+// x -> a * x + b
+struct Affine
+{
+    double a = 1;
+    double b = 0;
+    // был SET: a = 0, и b вычисляется теми же операциями, что и регистр при последовательном прогоне
+    bool constant = false;
+    // границы |a| и |b| промежуточных отображений серии, считая тождественное в начале
+    double max_a = 1;
+    double min_a = 1;
+    double max_b = 0;
+    // границы b / a промежуточных отображений: значение регистра после k-й операции серии - a_k * (x + b_k / a_k)
+    double min_offset = 0;
+    double max_offset = 0;
+    // инструкции серии [first, last) в Chunk::instructions
+    std::size_t first = 0;
+    std::size_t last = 0;
+
+    // свёртку можно продлевать, пока коэффициенты конечны, а a не обнуляется и не теряет точность
+    bool regular() const
+    {
+        return constant || (std::isnormal(a) && (b == 0 || std::isnormal(b)));
+    }
+
+    // Значение после серии. Свёртка применяется, только если ни одно промежуточное значение
+    // последовательного прогона не может переполниться или уйти в субнормальные числа и если
+    // в серии нет сокращения: наибольшие |x + b_k / a_k| и |b_k / a_k| вместе с |x| не больше
+    // 4 |x + b / a|, тогда свёртка отличается от последовательного прогона не больше чем на оценку
+    // из calc.h. Иначе, в том числе для бесконечностей и NaN, серия выполняется по одной операции.
+    double apply(const double x, const std::vector<Instruction> & instructions) const
+    {
+        if (constant) {
+            return b;
+        }
+        const double magnitude = std::fabs(x);
+        if (magnitude * max_a + max_b <= magnitude_limit && (x == 0 || magnitude * min_a >= std::numeric_limits<double>::min()) &&
+            cancellation_free(x)) {
+            // без сложений знак нуля определяют только * и /, как и при последовательном прогоне
+            return max_b == 0 ? a * x : a * x + b;
+        }
+        double current = x;
+        for (std::size_t i = first; i < last; ++i) {
+            bool rad_on = false;
+            Error error = Error::NONE;
+            current = dispatch(instructions[i], current, rad_on, error);
+        }
+        return current;
+    }
+
+    // |x + b_k / a_k| не больше наибольшего из значений на границах, |b_k / a_k| - наибольшей из границ
+    bool cancellation_free(const double x) const
+    {
+        const double spread = std::max(std::fabs(x + min_offset), std::fabs(x + max_offset)) + std::max(-min_offset, max_offset) + std::fabs(x);
+        return spread <= 4 * std::fabs(x + b / a);
+    }
+};
+
+// серия аффинных операций и следующая за ней операция, которую нужно выполнить честно
+struct Piece
+{
+    Affine run;
+    Instruction barrier;
+    Mode mode;
+};
+
+struct Chunk
+{
+    // байты лога [first, last), кусок начинается с начала строки
+    std::size_t first;
+    std::size_t last;
+    // по инструкции на строку, у строк с ошибками - Op::ERR
+    std::vector<Instruction> instructions;
+    std::vector<Piece> pieces;
+    Affine tail;
+    Mode mode = Mode::INHERITED;
+    double start = 0;
+    bool start_rad_on = false;
+    double finish = 0;
+    std::string out;
+    std::string log;
+};
+
+template <class F>
+void for_each_chunk(std::vector<Chunk> & chunks, const std::size_t threads, F && f)
+{
+    std::atomic<std::size_t> next{0};
+    const auto work = [&] {
+        for (std::size_t i = next++; i < chunks.size(); i = next++) {
+            f(chunks[i]);
+        }
+    };
+    std::vector<std::thread> workers;
+    for (std::size_t i = 1; i < threads; ++i) {
+        workers.emplace_back(work);
+    }
+    work();
+    for (auto & worker : workers) {
+        worker.join();
+    }
+}
+
+std::vector<Chunk> split(const std::string & text, const std::size_t count)
+{
+    std::vector<Chunk> chunks;
+    const std::size_t size = std::max<std::size_t>(text.size() / count, 1);
+    std::size_t first = 0;
+    while (first < text.size()) {
+        std::size_t last = text.find('\n', std::min(first + size, text.size()) - 1);
+        last = last == std::string::npos ? text.size() : last + 1;
+        chunks.push_back(Chunk{first, last, {}, {}, {}, Mode::INHERITED, 0, false, 0, {}, {}});
+        first = last;
+    }
+    return chunks;
+}
+
+// строки куска без '\n', как их возвращает std::getline
+template <class F>
+void for_each_line(const std::string & text, const Chunk & chunk, F && f)
+{
+    std::size_t first = chunk.first;
+    while (first < chunk.last) {
+        std::size_t last = text.find('\n', first);
+        if (last == std::string::npos || last > chunk.last) {
+            last = chunk.last;
+        }
+        f(std::string_view(text).substr(first, last - first));
+        first = last + 1;
+    }
+}
+
+bool is_affine(const Instruction & instruction)
+{
+    switch (instruction.op) {
+    case Op::SET:
+    case Op::ADD:
+    case Op::SUB:
+    case Op::DIV:
+    case Op::NEG:
+    case Op::RAD:
+    case Op::DEG:
+    case Op::ERR:
+        return true;
+    case Op::MUL:
+        // умножение на 0 превращает бесконечность в NaN, в свёртке это не выразить
+        return instruction.arg != 0;
+    default:
+        return false;
+    }
+}
+
+// серия, продлённая инструкцией, которая стоит в логе сразу за ней
+Affine then(Affine run, const Instruction & instruction)
+{
+    ++run.last;
+    switch (instruction.op) {
+    case Op::SET:
+        run.a = 0;
+        run.b = instruction.arg;
+        run.constant = true;
+        break;
+    case Op::ADD: run.b += instruction.arg; break;
+    case Op::SUB: run.b -= instruction.arg; break;
+    case Op::MUL:
+        run.a *= instruction.arg;
+        run.b *= instruction.arg;
+        break;
+    case Op::DIV:
+        if (instruction.arg != 0) {
+            run.a /= instruction.arg;
+            run.b /= instruction.arg;
+        }
+        break;
+    case Op::NEG:
+        run.a = -run.a;
+        run.b = -run.b;
+        break;
+    default: break;
+    }
+    run.max_a = std::max(run.max_a, std::fabs(run.a));
+    run.min_a = std::min(run.min_a, std::fabs(run.a));
+    run.max_b = std::max(run.max_b, std::fabs(run.b));
+    if (!run.constant) {
+        run.min_offset = std::min(run.min_offset, run.b / run.a);
+        run.max_offset = std::max(run.max_offset, run.b / run.a);
+    }
+    return run;
+}
+
+void summarize(const std::string & text, Chunk & chunk)
+{
+    for_each_line(text, chunk, [&](const std::string_view line) {
+        Instruction instruction{Op::ERR, 0};
+        std::size_t position;
+        parse_line(line, instruction, position);
+        chunk.instructions.push_back(instruction);
+    });
+    for (std::size_t i = 0; i < chunk.instructions.size(); ++i) {
+        const auto & instruction = chunk.instructions[i];
+        if (instruction.op == Op::RAD) {
+            chunk.mode = Mode::RAD;
+        }
+        else if (instruction.op == Op::DEG) {
+            chunk.mode = Mode::DEG;
+        }
+        if (is_affine(instruction)) {
+            const Affine run = then(chunk.tail, instruction);
+            if (run.regular()) {
+                chunk.tail = run;
+                continue;
+            }
+        }
+        // неаффинная операция или та, на которой свёртка вырождается, выполняется честно
+        chunk.pieces.push_back({chunk.tail, instruction, chunk.mode});
+        chunk.tail = Affine();
+        chunk.tail.first = i + 1;
+        chunk.tail.last = i + 1;
+    }
+}
+
+bool resolve(const Mode mode, const bool inherited)
+{
+    return mode == Mode::INHERITED ? inherited : mode == Mode::RAD;
+}
+
+// начальные значения кусков: свёрнутые серии применяются за O(1), остальные операции выполняются
+void propagate(std::vector<Chunk> & chunks, double current, bool rad_on)
+{
+    for (auto & chunk : chunks) {
+        chunk.start = current;
+        chunk.start_rad_on = rad_on;
+        for (const auto & piece : chunk.pieces) {
+            bool mode = resolve(piece.mode, rad_on);
+            Error error = Error::NONE;
+            current = dispatch(piece.barrier, piece.run.apply(current, chunk.instructions), mode, error);
+        }
+        current = chunk.tail.apply(current, chunk.instructions);
+        rad_on = resolve(chunk.mode, rad_on);
+    }
+}
+
+// значения после каждой строки куска, последовательно от его начального значения;
+// числа форматируются так же, как в потоках, куда они попадут
+void evaluate(const std::string & text, Chunk & chunk, const std::ostream & out_format, const std::ostream & log_format)
+{
+    std::ostringstream out;
+    std::ostringstream log;
+    out.copyfmt(out_format);
+    log.copyfmt(log_format);
+    double current = chunk.start;
+    bool rad_on = chunk.start_rad_on;
+    std::size_t i = 0;
+    for_each_line(text, chunk, [&](const std::string_view line) {
+        const Instruction & instruction = chunk.instructions[i++];
+        Result result{current, Error::NONE, 0};
+        if (instruction.op == Op::ERR) {
+            // сообщения о синтаксических ошибках нужны в порядке строк, поэтому разбор повторяется
+            Instruction ignored{Op::ERR, 0};
+            result.error = parse_line(line, ignored, result.position);
+        }
+        else {
+            result.value = step(instruction, current, rad_on, result.error);
+        }
+        report(log, line, result);
+        current = result.value;
+        out << current << '\n';
+    });
+    chunk.finish = current;
+    chunk.out = out.str();
+    chunk.log = log.str();
+    chunk.instructions = {};
+}
+
+} // anonymous namespace
+
+double replay(const std::string & text, const double current, bool & rad_on, std::ostream & out, std::ostream & log, std::size_t threads)
+{
+    threads = std::max<std::size_t>(threads, 1);
+    auto chunks = split(text, threads * chunks_per_thread);
+    if (chunks.empty()) {
+        return current;
+    }
+    for_each_chunk(chunks, threads, [&](Chunk & chunk) {
+        summarize(text, chunk);
+    });
+    propagate(chunks, current, rad_on);
+    for_each_chunk(chunks, threads, [&](Chunk & chunk) {
+        evaluate(text, chunk, out, log);
+    });
+    for (const auto & chunk : chunks) {
+        out << chunk.out;
+        log << chunk.log;
+    }
+    rad_on = resolve(chunks.back().mode, chunks.back().start_rad_on);
+    return chunks.back().finish;
+}
@@ -0,0 +1,120 @@
+#include "stats.h"
+
+#include <atomic>
+#include <iomanip>
+#include <ostream>
+
+namespace {
+
+constexpr std::size_t op_count = static_cast<std::size_t>(Op::DEG) + 1;
+constexpr std::size_t error_count = static_cast<std::size_t>(Error::BAD_SQRT) + 1;
+// в корзине b - задержки из [2^(b - 1), 2^b), в нулевой - нулевые
+constexpr std::size_t bucket_count = 65;
+
+const char * const op_names[op_count]{
+        "ERR", "SET", "ADD", "SUB", "MUL", "DIV", "REM", "NEG", "POW", "SQRT",
+        "SIN", "COS", "TAN", "CTN", "ASIN", "ACOS", "ATAN", "ACTN", "RAD", "DEG"};
+
+const char * const error_names[error_count]{
+        "NONE", "UNKNOWN_OPERATION", "NO_ARGUMENT", "BAD_ARGUMENT", "ARGUMENT_SUFFIX",
+        "UNARY_SUFFIX", "BAD_DIVISOR", "BAD_REMAINDER", "BAD_SQRT"};
+
+// счётчики общие для потоков replay
+struct OpStats
+{
+    std::atomic<std::uint64_t> count;
+    std::atomic<std::uint64_t> cycles;
+    std::atomic<std::uint64_t> histogram[bucket_count];
+};
+
+OpStats op_stats[op_count];
+std::atomic<std::uint64_t> errors[error_count];
+
+std::size_t bucket(std::uint64_t cycles)
+{
+    std::size_t b = 0;
+    while (cycles != 0) {
+        cycles >>= 1;
+        ++b;
+    }
+    return b;
+}
+
+// верхняя граница корзины, в которую попадает доля share выполнений
+std::uint64_t percentile(const OpStats & stats, const std::uint64_t count, const double share)
+{
+    const auto target = static_cast<std::uint64_t>(share * static_cast<double>(count));
+    std::uint64_t seen = 0;
+    for (std::size_t b = 0; b < bucket_count; ++b) {
+        seen += stats.histogram[b].load(std::memory_order_relaxed);
+        if (seen > target) {
+            return b == 0 ? 0 : (b == 64 ? UINT64_MAX : (std::uint64_t{1} << b) - 1);
+        }
+    }
+    return UINT64_MAX;
+}
+
+} // anonymous namespace
+
+void stats::count_step(const Op op, const std::uint64_t cycles)
+{
+    auto & stats = op_stats[static_cast<std::size_t>(op)];
+    stats.count.fetch_add(1, std::memory_order_relaxed);
+    stats.cycles.fetch_add(cycles, std::memory_order_relaxed);
+    stats.histogram[bucket(cycles)].fetch_add(1, std::memory_order_relaxed);
+}
+
+void stats::count_error(const Error error)
+{
+    errors[static_cast<std::size_t>(error)].fetch_add(1, std::memory_order_relaxed);
+}
+
+void stats::print(std::ostream & out)
+{
+    if (!enabled) {
+        out << "Statistics are not collected: calc_trig is built without CALC_STATS" << std::endl;
+        return;
+    }
+    std::uint64_t total = 0;
+    for (const auto & stats : op_stats) {
+        total += stats.cycles.load(std::memory_order_relaxed);
+    }
+    out << std::left << std::setw(6) << "op" << std::right << std::setw(12) << "count" << std::setw(8) << "time%"
+        << std::setw(12) << "mean" << std::setw(10) << "p50" << std::setw(10) << "p90" << std::setw(10) << "p99"
+        << "  (cycles)" << std::endl;
+    for (std::size_t i = 0; i < op_count; ++i) {
+        const auto & stats = op_stats[i];
+        const auto count = stats.count.load(std::memory_order_relaxed);
+        if (count == 0) {
+            continue;
+        }
+        const auto cycles = stats.cycles.load(std::memory_order_relaxed);
+        out << std::left << std::setw(6) << op_names[i] << std::right << std::setw(12) << count << std::setw(8)
+            << std::fixed << std::setprecision(1) << (total == 0 ? 0.0 : 100.0 * static_cast<double>(cycles) / static_cast<double>(total))
+            << std::setw(12) << static_cast<double>(cycles) / static_cast<double>(count) << std::defaultfloat
+            << std::setw(10) << percentile(stats, count, 0.5) << std::setw(10) << percentile(stats, count, 0.9)
+            << std::setw(10) << percentile(stats, count, 0.99) << std::endl;
+    }
+    out << "histograms (cycles: count)" << std::endl;
+    for (std::size_t i = 0; i < op_count; ++i) {
+        const auto & stats = op_stats[i];
+        if (stats.count.load(std::memory_order_relaxed) == 0) {
+            continue;
+        }
+        out << std::left << std::setw(6) << op_names[i] << std::right;
+        for (std::size_t b = 0; b < bucket_count; ++b) {
+            const auto n = stats.histogram[b].load(std::memory_order_relaxed);
+            if (n != 0) {
+                out << "  " << (b == 0 ? 0 : std::uint64_t{1} << (b - 1)) << "+: " << n;
+            }
+        }
+        out << std::endl;
+    }
+    out << "errors" << std::endl;
+    for (std::size_t i = 1; i < error_count; ++i) {
+        const auto n = errors[i].load(std::memory_order_relaxed);
+        if (n != 0) {
+            out << std::left << std::setw(18) << error_names[i] << std::right << std::setw(12) << n << std::endl;
+        }
+    }
+}
@@ -0,0 +1,112 @@
+#include "trig.h"
+
+namespace {
+
+// x градусов = quadrant * 90 + r, без ограничения на x; fmod точен при любом аргументе
+double reduce_any_degrees(const double x, double & quadrant)
+{
+    return trig::reduce_degrees(std::fabs(x) <= trig::degree_limit ? x : std::fmod(x, 360), quadrant);
+}
+
+// синус (shift = 0) или косинус (shift = 1)
+double sin_cos(const double x, const bool rad_on, const Precision precision, const int shift)
+{
+    double quadrant;
+    double s;
+    double c;
+    if (rad_on) {
+        if (precision == Precision::PRECISE || !(std::fabs(x) <= trig::reduction_limit)) {
+            return shift == 0 ? std::sin(x) : std::cos(x);
+        }
+        const double r = trig::reduce(x, quadrant);
+        s = trig::sin_poly(r);
+        c = trig::cos_poly(r);
+    }
+    else {
+        const double r = reduce_any_degrees(x, quadrant);
+        if (precision == Precision::PRECISE) {
+            // нужна только одна из двух функций
+            const bool odd = std::fabs(quadrant + shift) == 1 || quadrant + shift == 3;
+            s = odd ? 0 : trig::exact_sin_degrees(r, std::sin(r * trig::deg_to_rad));
+            c = odd ? trig::exact_cos_degrees(r, std::cos(r * trig::deg_to_rad)) : 0;
+        }
+        else {
+            s = trig::exact_sin_degrees(r, trig::sin_poly(r * trig::deg_to_rad));
+            c = trig::exact_cos_degrees(r, trig::cos_poly(r * trig::deg_to_rad));
+        }
+    }
+    return trig::by_quadrant(s, c, quadrant + shift);
+}
+
+} // anonymous namespace
+
+double trig::sin(const double x, const bool rad_on, const Precision precision)
+{
+    return sin_cos(x, rad_on, precision, 0);
+}
+
+double trig::cos(const double x, const bool rad_on, const Precision precision)
+{
+    return sin_cos(x, rad_on, precision, 1);
+}
+
+double trig::tan(const double x, const bool rad_on, const Precision precision)
+{
+    double quadrant;
+    if (rad_on) {
+        if (precision == Precision::PRECISE || !(std::fabs(x) <= reduction_limit)) {
+            return std::tan(x);
+        }
+        const double r = reduce(x, quadrant);
+        return tan_by_quadrant(sin_poly(r), cos_poly(r), quadrant);
+    }
+    const double r = reduce_any_degrees(x, quadrant);
+    const double radians = r * deg_to_rad;
+    if (precision == Precision::PRECISE) {
+        return exact_tan_degrees(r, quadrant, false, tan_by_quadrant(std::sin(radians), std::cos(radians), quadrant));
+    }
+    return exact_tan_degrees(r, quadrant, false, tan_by_quadrant(sin_poly(radians), cos_poly(radians), quadrant));
+}
+
+double trig::ctn(const double x, const bool rad_on, const Precision precision)
+{
+    const double v = invert_tan(tan(x, rad_on, precision));
+    if (rad_on) {
+        return v;
+    }
+    double quadrant;
+    const double r = reduce_any_degrees(x, quadrant);
+    return exact_tan_degrees(r, quadrant, true, v);
+}
+
+double trig::asin(const double x, const bool rad_on, const Precision precision)
+{
+    const double v = precision == Precision::PRECISE ? std::asin(x) : asin_poly(x);
+    return rad_on ? v : exact_asin_degrees(x, to_degrees(v));
+}
+
+double trig::acos(const double x, const bool rad_on, const Precision precision)
+{
+    const double v = precision == Precision::PRECISE ? std::acos(x) : acos_poly(x);
+    return rad_on ? v : exact_acos_degrees(x, to_degrees(v));
+}
+
+double trig::atan(const double x, const bool rad_on, const Precision precision)
+{
+    const double v = precision == Precision::PRECISE ? std::atan(x) : atan_poly(x);
+    return rad_on ? v : exact_atan_degrees(x, to_degrees(v));
+}
+
+double trig::actn(const double x, const bool rad_on, const Precision precision)
+{
+    double v;
+    if (precision == Precision::PRECISE) {
+        const double t = 1 / x;
+        const double a = std::atan(t);
+        v = t < 0 ? M_PI + a : a;
+    }
+    else {
+        v = actn_poly(x);
+    }
+    return rad_on ? v : exact_actn_degrees(x, to_degrees(v));
+}
@@ -0,0 +1,244 @@
+#include "binomial.h"
+#include "genetic_drift.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Сравнение способов розыгрыша поколения: поэлементного (эталон) и биномиального.
+// 1. Критерий хи-квадрат: выборки каждого способа против точного распределения Binomial(n, p)
+//    в режимах обращения и BTPE; поэлементному способу даётся не больше draws вызовов генератора.
+// 2. Вероятности исчезновения и фиксации обоими способами, z-критерий для разности долей.
+// 3. Время одного прогона calculate_drift_probabilities и ускорение.
+// Выход с кодом 1, если какой-нибудь критерий отвергает равенство распределений на уровне alpha.
+// Usage: drift_sampling [--samples n] [--draws n] [--runs n] [--sizes 100,1000,...] [--generations K] [--budget seconds]
+
+namespace {
+
+struct Options
+{
+    std::size_t samples = 20000;
+    double draws = 2e8;
+    unsigned long runs = 20000;
+    std::vector<unsigned> sizes{100, 1000, 10000, 100000, 1000000};
+    unsigned generations = 100;
+    double budget = 1;
+};
+
+const double alpha = 1e-3;
+
+std::vector<unsigned> split(const std::string & list)
+{
+    std::vector<unsigned> result;
+    std::istringstream is(list);
+    std::string item;
+    while (std::getline(is, item, ','))
+    {
+        result.push_back(static_cast<unsigned>(std::stod(item)));
+    }
+    return result;
+}
+
+Options parse(const int argc, char ** argv)
+{
+    Options options;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        const std::string name = argv[i];
+        const std::string value = argv[i + 1];
+        if (name == "--samples")
+        {
+            options.samples = static_cast<std::size_t>(std::stod(value));
+        }
+        else if (name == "--draws")
+        {
+            options.draws = std::stod(value);
+        }
+        else if (name == "--runs")
+        {
+            options.runs = static_cast<unsigned long>(std::stod(value));
+        }
+        else if (name == "--sizes")
+        {
+            options.sizes = split(value);
+        }
+        else if (name == "--generations")
+        {
+            options.generations = static_cast<unsigned>(std::stod(value));
+        }
+        else if (name == "--budget")
+        {
+            options.budget = std::stod(value);
+        }
+    }
+    return options;
+}
+
+// регуляризованная верхняя неполная гамма-функция Q(a, x): рядом при x < a + 1, иначе цепной дробью
+double gamma_q(const double a, const double x)
+{
+    if (x <= 0)
+    {
+        return 1;
+    }
+    const double log_prefix = a * std::log(x) - x - std::lgamma(a);
+    if (x < a + 1)
+    {
+        double term = 1 / a;
+        double sum = term;
+        for (int n = 1; n < 10000 && std::fabs(term) > std::fabs(sum) * 1e-15; ++n)
+        {
+            term *= x / (a + n);
+            sum += term;
+        }
+        return 1 - sum * std::exp(log_prefix);
+    }
+    const double tiny = 1e-300;
+    double b = x + 1 - a;
+    double c = 1 / tiny;
+    double d = 1 / b;
+    double h = d;
+    for (int i = 1; i < 10000; ++i)
+    {
+        const double an = -i * (i - a);
+        b += 2;
+        d = an * d + b;
+        d = std::fabs(d) < tiny ? tiny : d;
+        c = b + an / c;
+        c = std::fabs(c) < tiny ? tiny : c;
+        d = 1 / d;
+        const double delta = d * c;
+        h *= delta;
+        if (std::fabs(delta - 1) < 1e-15)
+        {
+            break;
+        }
+    }
+    return std::exp(log_prefix) * h;
+}
+
+double binomial_pmf(const unsigned long long n, const unsigned long long k, const double p)
+{
+    const double nd = static_cast<double>(n);
+    const double kd = static_cast<double>(k);
+    return std::exp(std::lgamma(nd + 1) - std::lgamma(kd + 1) - std::lgamma(nd - kd + 1) + kd * std::log(p) + (nd - kd) * std::log1p(-p));
+}
+
+struct ChiSquare
+{
+    double statistic;
+    std::size_t dof;
+    double p_value;
+};
+
+// соседние значения объединяются, пока ожидаемое число попаданий в группу меньше 5
+ChiSquare chi_square(const std::vector<std::size_t> & observed, const unsigned long long n, const double p, const std::size_t samples)
+{
+    double statistic = 0;
+    std::size_t groups = 0;
+    double expected = 0;
+    double seen = 0;
+    for (unsigned long long k = 0; k <= n; ++k)
+    {
+        expected += binomial_pmf(n, k, p) * static_cast<double>(samples);
+        seen += static_cast<double>(observed[k]);
+        if (expected >= 5 || k == n)
+        {
+            statistic += (seen - expected) * (seen - expected) / expected;
+            ++groups;
+            expected = 0;
+            seen = 0;
+        }
+    }
+    const std::size_t dof = groups > 1 ? groups - 1 : 1;
+    return {statistic, dof, gamma_q(static_cast<double>(dof) / 2, statistic / 2)};
+}
+
+double seconds_per_run(const unsigned N, const unsigned K, const Sampling sampling, const double budget)
+{
+    unsigned long runs = 1;
+    while (true)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        calculate_drift_probabilities(runs, N, K, 0.5, sampling);
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        if (elapsed.count() >= budget / 4 || runs >= (1ul << 30))
+        {
+            return elapsed.count() / static_cast<double>(runs);
+        }
+        runs *= 2;
+    }
+}
+
+} // anonymous namespace
+
+int main(int argc, char ** argv)
+{
+    const Options options = parse(argc, argv);
+    bool rejected = false;
+
+    std::printf("Chi-square goodness of fit to Binomial(n, p)\n");
+    std::printf("%10s %8s %10s %10s %10s %12s %6s %10s\n", "n", "p", "mean", "sampler", "samples", "chi2", "dof", "p-value");
+    const std::pair<unsigned long long, double> cases[] = {
+            {20, 0.3}, {200, 0.01}, {200, 0.1}, {200, 0.5}, {200, 0.97}, {2000, 0.02}, {2000, 0.3}, {20000, 0.5}, {200000, 0.0001}, {200000, 0.2}};
+    const std::pair<const char *, std::function<unsigned long long(unsigned long long, double)>> samplers[] = {
+            {"bernoulli", sample_bernoulli}, {"binomial", sample_binomial}};
+    for (const auto & [n, p] : cases)
+    {
+        for (const auto & [name, sample] : samplers)
+        {
+            const bool bernoulli = name == samplers[0].first;
+            const std::size_t samples = bernoulli ? std::min(options.samples, static_cast<std::size_t>(options.draws / static_cast<double>(n)) + 1) : options.samples;
+            std::vector<std::size_t> observed(n + 1);
+            for (std::size_t i = 0; i < samples; ++i)
+            {
+                ++observed[sample(n, p)];
+            }
+            const auto test = chi_square(observed, n, p, samples);
+            rejected = rejected || test.p_value < alpha;
+            std::printf("%10llu %8g %10g %10s %10zu %12.2f %6zu %10.4f\n", n, p, static_cast<double>(n) * p, name, samples, test.statistic, test.dof, test.p_value);
+            std::fflush(stdout);
+        }
+    }
+
+    std::printf("\nDrift probabilities, %lu runs, two-proportion z-test\n", options.runs);
+    std::printf("%6s %6s %6s %14s %14s %14s %14s %10s %10s\n", "N", "K", "p", "bernoulli d", "binomial d", "bernoulli f", "binomial f", "p-value d", "p-value f");
+    const struct
+    {
+        unsigned N;
+        unsigned K;
+        double p;
+    } drifts[] = {{10, 100, 0.3}, {50, 200, 0.5}, {100, 1000, 0.1}};
+    for (const auto & drift : drifts)
+    {
+        const auto [d1, f1] = calculate_drift_probabilities(options.runs, drift.N, drift.K, drift.p, Sampling::Bernoulli);
+        const auto [d2, f2] = calculate_drift_probabilities(options.runs, drift.N, drift.K, drift.p, Sampling::Binomial);
+        const auto p_value = [&options](const double a, const double b) {
+            const double pooled = (a + b) / 2;
+            const double se = std::sqrt(pooled * (1 - pooled) * 2 / static_cast<double>(options.runs));
+            return se == 0 ? (a == b ? 1.0 : 0.0) : std::erfc(std::fabs(a - b) / se / std::sqrt(2.0));
+        };
+        const double pd = p_value(d1, d2);
+        const double pf = p_value(f1, f2);
+        rejected = rejected || pd < alpha || pf < alpha;
+        std::printf("%6u %6u %6g %14.5f %14.5f %14.5f %14.5f %10.4f %10.4f\n", drift.N, drift.K, drift.p, d1, d2, f1, f2, pd, pf);
+    }
+
+    std::printf("\nSeconds per run, K = %u, p = 0.5\n", options.generations);
+    std::printf("%10s %14s %14s %10s\n", "N", "bernoulli", "binomial", "speedup");
+    for (const unsigned N : options.sizes)
+    {
+        const double bernoulli = seconds_per_run(N, options.generations, Sampling::Bernoulli, options.budget);
+        const double binomial = seconds_per_run(N, options.generations, Sampling::Binomial, options.budget);
+        std::printf("%10u %14.3e %14.3e %10.1f\n", N, bernoulli, binomial, bernoulli / binomial);
+        std::fflush(stdout);
+    }
+
+    std::printf("\n%s at alpha = %g\n", rejected ? "FAIL: distributions differ" : "OK: no difference detected", alpha);
+    return rejected ? 1 : 0;
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+// Число успехов в n испытаниях с вероятностью успеха p, случайные числа берутся из get_random_number().
+
+// эталон: n вызовов get_random_number(), успех - число не больше p
+unsigned long long sample_bernoulli(unsigned long long n, double p);
+
+// Точная выборка из Binomial(n, p) за O(1) вызовов get_random_number() в среднем:
+// обращением функции распределения при n * min(p, 1 - p) < 30 и алгоритмом BTPE
+// (Kachitvichyanukul, Schmeiser, 1988) при больших средних
+unsigned long long sample_binomial(unsigned long long n, double p);
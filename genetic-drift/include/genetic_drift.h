@@ -2,4 +2,12 @@
 
 #include <utility>
 
-std::pair<double, double> calculate_drift_probabilities(unsigned long runs, unsigned N, unsigned K, double p);
+// как разыгрывается следующее поколение: каждая из 2N аллелей отдельно (эталон)
+// или сразу число синих аллелей из Binomial(2N, p) - распределение то же, но быстрее
+enum class Sampling
+{
+    Bernoulli,
+    Binomial
+};
+
+std::pair<double, double> calculate_drift_probabilities(unsigned long runs, unsigned N, unsigned K, double p, Sampling sampling = Sampling::Binomial);
@@ -0,0 +1,197 @@
+#include "binomial.h"
+
+#include "random_gen.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// при меньшем среднем обращение в среднем быстрее, чем BTPE
+const double inversion_mean_limit = 30;
+
+// последовательный поиск по функции распределения от нуля, p <= 0.5;
+// хвост дальше bound почти невероятен, и выборка в нём начинается заново
+unsigned long long inversion(const unsigned long long n, const double p)
+{
+    const double q = 1 - p;
+    const double qn = std::exp(static_cast<double>(n) * std::log(q));
+    const double np = static_cast<double>(n) * p;
+    const auto bound = static_cast<unsigned long long>(std::min(static_cast<double>(n), np + 10 * std::sqrt(np * q + 1)));
+    unsigned long long x = 0;
+    double px = qn;
+    double u = get_random_number();
+    while (u > px)
+    {
+        ++x;
+        if (x > bound)
+        {
+            x = 0;
+            px = qn;
+            u = get_random_number();
+        }
+        else
+        {
+            u -= px;
+            px = (static_cast<double>(n - x + 1) * p * px) / (static_cast<double>(x) * q);
+        }
+    }
+    return x;
+}
+
+// поправка Стирлинга для сравнения с точной плотностью в BTPE
+double stirling_correction(const double x)
+{
+    const double x2 = x * x;
+    return (13860. - (462. - (132. - (99. - 140. / x2) / x2) / x2) / x2) / x / 166320.;
+}
+
+// BTPE: мажоранта из треугольника, двух параллелограммов и двух экспоненциальных хвостов, p <= 0.5
+unsigned long long btpe(const unsigned long long n, const double p)
+{
+    const double nd = static_cast<double>(n);
+    const double r = p;
+    const double q = 1 - r;
+    const double nrq = nd * r * q;
+    const double fm = nd * r + r;
+    const auto m = static_cast<long long>(std::floor(fm));
+    const double md = static_cast<double>(m);
+    const double p1 = std::floor(2.195 * std::sqrt(nrq) - 4.6 * q) + 0.5;
+    const double xm = md + 0.5;
+    const double xl = xm - p1;
+    const double xr = xm + p1;
+    const double c = 0.134 + 20.5 / (15.3 + md);
+    double a = (fm - xl) / (fm - xl * r);
+    const double laml = a * (1 + a / 2);
+    a = (xr - fm) / (xr * q);
+    const double lamr = a * (1 + a / 2);
+    const double p2 = p1 * (1 + 2 * c);
+    const double p3 = p2 + c / laml;
+    const double p4 = p3 + c / lamr;
+
+    while (true)
+    {
+        const double u = get_random_number() * p4;
+        double v = get_random_number();
+        long long y;
+        if (u <= p1)
+        {
+            // треугольник: принимается сразу
+            return static_cast<unsigned long long>(std::floor(xm - p1 * v + u));
+        }
+        if (u <= p2)
+        {
+            const double x = xl + (u - p1) / c;
+            v = v * c + 1 - std::fabs(md - x + 0.5) / p1;
+            if (v > 1)
+            {
+                continue;
+            }
+            y = static_cast<long long>(std::floor(x));
+        }
+        else if (u <= p3)
+        {
+            // при v = 0 логарифм - бесконечность, её нельзя привести к целому
+            if (v == 0)
+            {
+                continue;
+            }
+            const double x = std::floor(xl + std::log(v) / laml);
+            if (x < 0)
+            {
+                continue;
+            }
+            y = static_cast<long long>(x);
+            v = v * (u - p2) * laml;
+        }
+        else
+        {
+            if (v == 0)
+            {
+                continue;
+            }
+            const double x = std::floor(xr - std::log(v) / lamr);
+            if (x > nd)
+            {
+                continue;
+            }
+            y = static_cast<long long>(x);
+            v = v * (u - p3) * lamr;
+        }
+
+        const long long k = y > m ? y - m : m - y;
+        const double kd = static_cast<double>(k);
+        if (k <= 20 || kd >= nrq / 2 - 1)
+        {
+            // плотность считается рекуррентно от моды
+            const double s = r / q;
+            const double as = s * (nd + 1);
+            double f = 1;
+            for (long long i = std::min(m, y) + 1; i <= std::max(m, y); ++i)
+            {
+                const double factor = as / static_cast<double>(i) - s;
+                f = m < y ? f * factor : f / factor;
+            }
+            if (v <= f)
+            {
+                return static_cast<unsigned long long>(y);
+            }
+            continue;
+        }
+
+        // сжатие по оценкам логарифма плотности, затем сравнение с ним по формуле Стирлинга
+        const double rho = (kd / nrq) * ((kd * (kd / 3 + 0.625) + 1.0 / 6) / nrq + 0.5);
+        const double t = -kd * kd / (2 * nrq);
+        const double log_v = std::log(v);
+        if (log_v < t - rho)
+        {
+            return static_cast<unsigned long long>(y);
+        }
+        if (log_v > t + rho)
+        {
+            continue;
+        }
+        const double yd = static_cast<double>(y);
+        const double x1 = yd + 1;
+        const double f1 = md + 1;
+        const double z = nd + 1 - md;
+        const double w = nd - yd + 1;
+        const double bound = xm * std::log(f1 / x1) + (nd - md + 0.5) * std::log(z / w) + (yd - md) * std::log(w * r / (x1 * q)) +
+                stirling_correction(f1) + stirling_correction(z) + stirling_correction(x1) + stirling_correction(w);
+        if (log_v <= bound)
+        {
+            return static_cast<unsigned long long>(y);
+        }
+    }
+}
+
+} // anonymous namespace
+
+unsigned long long sample_bernoulli(const unsigned long long n, const double p)
+{
+    unsigned long long count = 0;
+    for (unsigned long long i = 0; i < n; ++i)
+    {
+        if (get_random_number() <= p)
+        {
+            ++count;
+        }
+    }
+    return count;
+}
+
+unsigned long long sample_binomial(const unsigned long long n, const double p)
+{
+    if (p <= 0 || n == 0)
+    {
+        return 0;
+    }
+    if (p >= 1)
+    {
+        return n;
+    }
+    // выборка для min(p, 1 - p), для p > 0.5 - число неудач
+    const double r = std::min(p, 1 - p);
+    const unsigned long long x = static_cast<double>(n) * r < inversion_mean_limit ? inversion(n, r) : btpe(n, r);
+    return p > 0.5 ? n - x : x;
+}
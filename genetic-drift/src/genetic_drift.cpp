@@ -1,8 +1,27 @@
 #include "genetic_drift.h"
 
-#include "random_gen.h"
+#include "binomial.h"
 
-std::pair<double, double> calculate_drift_probabilities(const unsigned long runs, const unsigned N, const unsigned K, const double p)
+namespace {
+
+struct BernoulliSampler
+{
+    unsigned long long operator()(const unsigned long long n, const double p) const
+    {
+        return sample_bernoulli(n, p);
+    }
+};
+
+struct BinomialSampler
+{
+    unsigned long long operator()(const unsigned long long n, const double p) const
+    {
+        return sample_binomial(n, p);
+    }
+};
+
+template <class Sampler>
+std::pair<double, double> simulate(const unsigned long runs, const unsigned N, const unsigned K, const double p, const Sampler & sample)
 {
     if (runs == 0)
     {
@@ -24,14 +43,7 @@ std::pair<double, double> calculate_drift_probabilities(const unsigned long runs
         double probability_blue = p;
         for (unsigned generation = 0; generation < K; ++generation)
         {
-            unsigned long long count_blue = 0;
-            for (unsigned long long allele = 0; allele < count_alleles; ++allele)
-            {
-                if (get_random_number() <= probability_blue)
-                {
-                    ++count_blue;
-                }
-            }
+            const unsigned long long count_blue = sample(count_alleles, probability_blue);
             if (count_blue == 0)
             {
                 ++count_disappearance_blue;
@@ -48,3 +60,15 @@ std::pair<double, double> calculate_drift_probabilities(const unsigned long runs
     }
     return {static_cast<double>(count_disappearance_blue) / runs, static_cast<double>(count_disappearance_white) / runs};
 }
+
+} // anonymous namespace
+
+std::pair<double, double> calculate_drift_probabilities(const unsigned long runs, const unsigned N, const unsigned K, const double p, const Sampling sampling)
+{
+    switch (sampling)
+    {
+    case Sampling::Bernoulli: return simulate(runs, N, K, p, BernoulliSampler());
+    case Sampling::Binomial: return simulate(runs, N, K, p, BinomialSampler());
+    }
+    return {0.0, 0.0};
+}
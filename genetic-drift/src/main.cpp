@@ -9,6 +9,7 @@ int main(int argc, char ** argv)
     unsigned N = 100;
     unsigned K = 1000;
     double p = 0.3;
+    Sampling sampling = Sampling::Binomial;
     if (argc > 1) {
         runs = std::stoul(argv[1]);
         if (argc > 2) {
@@ -17,11 +18,14 @@ int main(int argc, char ** argv)
                 K = std::stoul(argv[3]);
                 if (argc > 4) {
                     p = std::stod(argv[4]);
+                    if (argc > 5 && std::string(argv[5]) == "bernoulli") {
+                        sampling = Sampling::Bernoulli;
+                    }
                 }
             }
         }
     }
-    const auto [d, f] = calculate_drift_probabilities(runs, N, K, p);
+    const auto [d, f] = calculate_drift_probabilities(runs, N, K, p, sampling);
     std::cout << "disappearance probability: " << d
         << "\nfixation probability: " << f << "\n";
 }